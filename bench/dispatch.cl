@@ -0,0 +1,9 @@
+; 3M iterations of a loop compiled by the virtual machine, which spends most of its time
+; dispatching its instructions (as each one does little): to compare threaded code with a
+; switch, run it with `bench/run.sh -D LVM_NO_THREADING dispatch`.
+(fun {spin n acc} {
+    if (== n 0)
+        {acc}
+        {spin (- n 1) (+ acc (* (- n (* (/ n 7) 7)) 3))}})
+
+(print (spin 3000000 0))
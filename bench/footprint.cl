@@ -0,0 +1,5 @@
+; Large lists of boxed values (see `peak-rss`), each of which used to take 96 bytes.
+(load "bench/data/mixed-100k.cl")
+
+(def {copies} (list mixed-100k mixed-100k mixed-100k mixed-100k))
+(print "copied")
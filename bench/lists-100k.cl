@@ -0,0 +1,9 @@
+; The list functions of the prelude over a list of 100k numbers, which are built-ins unless
+; `--no-native-lists` is given (with which some are quadratic, e.g. `last`): to compare
+; them, run it with `bench/run.sh -n 1 -f --no-native-lists lists-100k`.
+(load "bench/data/list-100k.cl")
+
+(print (len list-100k) (last list-100k) (nth 99999 list-100k) (elem 0 list-100k))
+(print (foldl + 0 (filter (\ {x} {== 0 (- x (* (/ x 2) 2))}) (map (\ {x} {* x 3}) list-100k))))
+(print (foldr + 0 (take 50000 (drop 25000 (reverse list-100k)))))
+(print (len (fst (unzip (zip list-100k list-100k)))))
@@ -0,0 +1,8 @@
+; Recursive prelude functions over a list of 10k numbers, each step of which took its tail
+; (i.e. copied it) before tails were slices.
+(load "bench/data/list-10k.cl")
+
+(print (len list-10k))
+(print (foldl + 0 list-10k))
+(print (elem 0 list-10k))
+(print (len (map (\ {x} {* x 2}) list-10k)))
@@ -0,0 +1,8 @@
+; Recursive prelude functions over a list of 1k numbers, each step of which took its tail
+; (i.e. copied it) before tails were slices.
+(load "bench/data/list-1k.cl")
+
+(print (len list-1k))
+(print (foldl + 0 list-1k))
+(print (elem 0 list-1k))
+(print (len (map (\ {x} {* x 2}) list-1k)))
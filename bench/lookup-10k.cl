@@ -0,0 +1,17 @@
+; 1M lookups of the last 100 of 10k globals (i.e. the cost of a lookup as globals are
+; added, since environments used to be scanned in order).
+(load "bench/data/globals-10k.cl")
+(load "bench/data/list-1k.cl")
+
+(def {f} (\ {_} {
+    + (+ g9901 g9902 g9903 g9904 g9905 g9906 g9907 g9908 g9909 g9910 g9911 g9912 g9913 g9914 g9915 g9916 g9917 g9918 g9919 g9920 g9921 g9922 g9923 g9924 g9925 g9926 g9927 g9928 g9929 g9930 g9931 g9932 g9933 g9934 g9935 g9936 g9937 g9938 g9939 g9940 g9941 g9942 g9943 g9944 g9945 g9946 g9947 g9948 g9949 g9950 g9951 g9952 g9953 g9954 g9955 g9956 g9957 g9958 g9959 g9960 g9961 g9962 g9963 g9964 g9965 g9966 g9967 g9968 g9969 g9970 g9971 g9972 g9973 g9974 g9975 g9976 g9977 g9978 g9979 g9980 g9981 g9982 g9983 g9984 g9985 g9986 g9987 g9988 g9989 g9990 g9991 g9992 g9993 g9994 g9995 g9996 g9997 g9998 g9999 g10000)
+      (+ g9901 g9902 g9903 g9904 g9905 g9906 g9907 g9908 g9909 g9910 g9911 g9912 g9913 g9914 g9915 g9916 g9917 g9918 g9919 g9920 g9921 g9922 g9923 g9924 g9925 g9926 g9927 g9928 g9929 g9930 g9931 g9932 g9933 g9934 g9935 g9936 g9937 g9938 g9939 g9940 g9941 g9942 g9943 g9944 g9945 g9946 g9947 g9948 g9949 g9950 g9951 g9952 g9953 g9954 g9955 g9956 g9957 g9958 g9959 g9960 g9961 g9962 g9963 g9964 g9965 g9966 g9967 g9968 g9969 g9970 g9971 g9972 g9973 g9974 g9975 g9976 g9977 g9978 g9979 g9980 g9981 g9982 g9983 g9984 g9985 g9986 g9987 g9988 g9989 g9990 g9991 g9992 g9993 g9994 g9995 g9996 g9997 g9998 g9999 g10000)
+      (+ g9901 g9902 g9903 g9904 g9905 g9906 g9907 g9908 g9909 g9910 g9911 g9912 g9913 g9914 g9915 g9916 g9917 g9918 g9919 g9920 g9921 g9922 g9923 g9924 g9925 g9926 g9927 g9928 g9929 g9930 g9931 g9932 g9933 g9934 g9935 g9936 g9937 g9938 g9939 g9940 g9941 g9942 g9943 g9944 g9945 g9946 g9947 g9948 g9949 g9950 g9951 g9952 g9953 g9954 g9955 g9956 g9957 g9958 g9959 g9960 g9961 g9962 g9963 g9964 g9965 g9966 g9967 g9968 g9969 g9970 g9971 g9972 g9973 g9974 g9975 g9976 g9977 g9978 g9979 g9980 g9981 g9982 g9983 g9984 g9985 g9986 g9987 g9988 g9989 g9990 g9991 g9992 g9993 g9994 g9995 g9996 g9997 g9998 g9999 g10000)
+      (+ g9901 g9902 g9903 g9904 g9905 g9906 g9907 g9908 g9909 g9910 g9911 g9912 g9913 g9914 g9915 g9916 g9917 g9918 g9919 g9920 g9921 g9922 g9923 g9924 g9925 g9926 g9927 g9928 g9929 g9930 g9931 g9932 g9933 g9934 g9935 g9936 g9937 g9938 g9939 g9940 g9941 g9942 g9943 g9944 g9945 g9946 g9947 g9948 g9949 g9950 g9951 g9952 g9953 g9954 g9955 g9956 g9957 g9958 g9959 g9960 g9961 g9962 g9963 g9964 g9965 g9966 g9967 g9968 g9969 g9970 g9971 g9972 g9973 g9974 g9975 g9976 g9977 g9978 g9979 g9980 g9981 g9982 g9983 g9984 g9985 g9986 g9987 g9988 g9989 g9990 g9991 g9992 g9993 g9994 g9995 g9996 g9997 g9998 g9999 g10000)
+      (+ g9901 g9902 g9903 g9904 g9905 g9906 g9907 g9908 g9909 g9910 g9911 g9912 g9913 g9914 g9915 g9916 g9917 g9918 g9919 g9920 g9921 g9922 g9923 g9924 g9925 g9926 g9927 g9928 g9929 g9930 g9931 g9932 g9933 g9934 g9935 g9936 g9937 g9938 g9939 g9940 g9941 g9942 g9943 g9944 g9945 g9946 g9947 g9948 g9949 g9950 g9951 g9952 g9953 g9954 g9955 g9956 g9957 g9958 g9959 g9960 g9961 g9962 g9963 g9964 g9965 g9966 g9967 g9968 g9969 g9970 g9971 g9972 g9973 g9974 g9975 g9976 g9977 g9978 g9979 g9980 g9981 g9982 g9983 g9984 g9985 g9986 g9987 g9988 g9989 g9990 g9991 g9992 g9993 g9994 g9995 g9996 g9997 g9998 g9999 g10000)
+      (+ g9901 g9902 g9903 g9904 g9905 g9906 g9907 g9908 g9909 g9910 g9911 g9912 g9913 g9914 g9915 g9916 g9917 g9918 g9919 g9920 g9921 g9922 g9923 g9924 g9925 g9926 g9927 g9928 g9929 g9930 g9931 g9932 g9933 g9934 g9935 g9936 g9937 g9938 g9939 g9940 g9941 g9942 g9943 g9944 g9945 g9946 g9947 g9948 g9949 g9950 g9951 g9952 g9953 g9954 g9955 g9956 g9957 g9958 g9959 g9960 g9961 g9962 g9963 g9964 g9965 g9966 g9967 g9968 g9969 g9970 g9971 g9972 g9973 g9974 g9975 g9976 g9977 g9978 g9979 g9980 g9981 g9982 g9983 g9984 g9985 g9986 g9987 g9988 g9989 g9990 g9991 g9992 g9993 g9994 g9995 g9996 g9997 g9998 g9999 g10000)
+      (+ g9901 g9902 g9903 g9904 g9905 g9906 g9907 g9908 g9909 g9910 g9911 g9912 g9913 g9914 g9915 g9916 g9917 g9918 g9919 g9920 g9921 g9922 g9923 g9924 g9925 g9926 g9927 g9928 g9929 g9930 g9931 g9932 g9933 g9934 g9935 g9936 g9937 g9938 g9939 g9940 g9941 g9942 g9943 g9944 g9945 g9946 g9947 g9948 g9949 g9950 g9951 g9952 g9953 g9954 g9955 g9956 g9957 g9958 g9959 g9960 g9961 g9962 g9963 g9964 g9965 g9966 g9967 g9968 g9969 g9970 g9971 g9972 g9973 g9974 g9975 g9976 g9977 g9978 g9979 g9980 g9981 g9982 g9983 g9984 g9985 g9986 g9987 g9988 g9989 g9990 g9991 g9992 g9993 g9994 g9995 g9996 g9997 g9998 g9999 g10000)
+      (+ g9901 g9902 g9903 g9904 g9905 g9906 g9907 g9908 g9909 g9910 g9911 g9912 g9913 g9914 g9915 g9916 g9917 g9918 g9919 g9920 g9921 g9922 g9923 g9924 g9925 g9926 g9927 g9928 g9929 g9930 g9931 g9932 g9933 g9934 g9935 g9936 g9937 g9938 g9939 g9940 g9941 g9942 g9943 g9944 g9945 g9946 g9947 g9948 g9949 g9950 g9951 g9952 g9953 g9954 g9955 g9956 g9957 g9958 g9959 g9960 g9961 g9962 g9963 g9964 g9965 g9966 g9967 g9968 g9969 g9970 g9971 g9972 g9973 g9974 g9975 g9976 g9977 g9978 g9979 g9980 g9981 g9982 g9983 g9984 g9985 g9986 g9987 g9988 g9989 g9990 g9991 g9992 g9993 g9994 g9995 g9996 g9997 g9998 g9999 g10000)
+      (+ g9901 g9902 g9903 g9904 g9905 g9906 g9907 g9908 g9909 g9910 g9911 g9912 g9913 g9914 g9915 g9916 g9917 g9918 g9919 g9920 g9921 g9922 g9923 g9924 g9925 g9926 g9927 g9928 g9929 g9930 g9931 g9932 g9933 g9934 g9935 g9936 g9937 g9938 g9939 g9940 g9941 g9942 g9943 g9944 g9945 g9946 g9947 g9948 g9949 g9950 g9951 g9952 g9953 g9954 g9955 g9956 g9957 g9958 g9959 g9960 g9961 g9962 g9963 g9964 g9965 g9966 g9967 g9968 g9969 g9970 g9971 g9972 g9973 g9974 g9975 g9976 g9977 g9978 g9979 g9980 g9981 g9982 g9983 g9984 g9985 g9986 g9987 g9988 g9989 g9990 g9991 g9992 g9993 g9994 g9995 g9996 g9997 g9998 g9999 g10000)
+      (+ g9901 g9902 g9903 g9904 g9905 g9906 g9907 g9908 g9909 g9910 g9911 g9912 g9913 g9914 g9915 g9916 g9917 g9918 g9919 g9920 g9921 g9922 g9923 g9924 g9925 g9926 g9927 g9928 g9929 g9930 g9931 g9932 g9933 g9934 g9935 g9936 g9937 g9938 g9939 g9940 g9941 g9942 g9943 g9944 g9945 g9946 g9947 g9948 g9949 g9950 g9951 g9952 g9953 g9954 g9955 g9956 g9957 g9958 g9959 g9960 g9961 g9962 g9963 g9964 g9965 g9966 g9967 g9968 g9969 g9970 g9971 g9972 g9973 g9974 g9975 g9976 g9977 g9978 g9979 g9980 g9981 g9982 g9983 g9984 g9985 g9986 g9987 g9988 g9989 g9990 g9991 g9992 g9993 g9994 g9995 g9996 g9997 g9998 g9999 g10000)}))
+(print (foldl + 0 (map f list-1k)))
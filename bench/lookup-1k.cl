@@ -0,0 +1,17 @@
+; 1M lookups of the last 100 of 1k globals (i.e. the cost of a lookup as globals are
+; added, since environments used to be scanned in order).
+(load "bench/data/globals-1k.cl")
+(load "bench/data/list-1k.cl")
+
+(def {f} (\ {_} {
+    + (+ g901 g902 g903 g904 g905 g906 g907 g908 g909 g910 g911 g912 g913 g914 g915 g916 g917 g918 g919 g920 g921 g922 g923 g924 g925 g926 g927 g928 g929 g930 g931 g932 g933 g934 g935 g936 g937 g938 g939 g940 g941 g942 g943 g944 g945 g946 g947 g948 g949 g950 g951 g952 g953 g954 g955 g956 g957 g958 g959 g960 g961 g962 g963 g964 g965 g966 g967 g968 g969 g970 g971 g972 g973 g974 g975 g976 g977 g978 g979 g980 g981 g982 g983 g984 g985 g986 g987 g988 g989 g990 g991 g992 g993 g994 g995 g996 g997 g998 g999 g1000)
+      (+ g901 g902 g903 g904 g905 g906 g907 g908 g909 g910 g911 g912 g913 g914 g915 g916 g917 g918 g919 g920 g921 g922 g923 g924 g925 g926 g927 g928 g929 g930 g931 g932 g933 g934 g935 g936 g937 g938 g939 g940 g941 g942 g943 g944 g945 g946 g947 g948 g949 g950 g951 g952 g953 g954 g955 g956 g957 g958 g959 g960 g961 g962 g963 g964 g965 g966 g967 g968 g969 g970 g971 g972 g973 g974 g975 g976 g977 g978 g979 g980 g981 g982 g983 g984 g985 g986 g987 g988 g989 g990 g991 g992 g993 g994 g995 g996 g997 g998 g999 g1000)
+      (+ g901 g902 g903 g904 g905 g906 g907 g908 g909 g910 g911 g912 g913 g914 g915 g916 g917 g918 g919 g920 g921 g922 g923 g924 g925 g926 g927 g928 g929 g930 g931 g932 g933 g934 g935 g936 g937 g938 g939 g940 g941 g942 g943 g944 g945 g946 g947 g948 g949 g950 g951 g952 g953 g954 g955 g956 g957 g958 g959 g960 g961 g962 g963 g964 g965 g966 g967 g968 g969 g970 g971 g972 g973 g974 g975 g976 g977 g978 g979 g980 g981 g982 g983 g984 g985 g986 g987 g988 g989 g990 g991 g992 g993 g994 g995 g996 g997 g998 g999 g1000)
+      (+ g901 g902 g903 g904 g905 g906 g907 g908 g909 g910 g911 g912 g913 g914 g915 g916 g917 g918 g919 g920 g921 g922 g923 g924 g925 g926 g927 g928 g929 g930 g931 g932 g933 g934 g935 g936 g937 g938 g939 g940 g941 g942 g943 g944 g945 g946 g947 g948 g949 g950 g951 g952 g953 g954 g955 g956 g957 g958 g959 g960 g961 g962 g963 g964 g965 g966 g967 g968 g969 g970 g971 g972 g973 g974 g975 g976 g977 g978 g979 g980 g981 g982 g983 g984 g985 g986 g987 g988 g989 g990 g991 g992 g993 g994 g995 g996 g997 g998 g999 g1000)
+      (+ g901 g902 g903 g904 g905 g906 g907 g908 g909 g910 g911 g912 g913 g914 g915 g916 g917 g918 g919 g920 g921 g922 g923 g924 g925 g926 g927 g928 g929 g930 g931 g932 g933 g934 g935 g936 g937 g938 g939 g940 g941 g942 g943 g944 g945 g946 g947 g948 g949 g950 g951 g952 g953 g954 g955 g956 g957 g958 g959 g960 g961 g962 g963 g964 g965 g966 g967 g968 g969 g970 g971 g972 g973 g974 g975 g976 g977 g978 g979 g980 g981 g982 g983 g984 g985 g986 g987 g988 g989 g990 g991 g992 g993 g994 g995 g996 g997 g998 g999 g1000)
+      (+ g901 g902 g903 g904 g905 g906 g907 g908 g909 g910 g911 g912 g913 g914 g915 g916 g917 g918 g919 g920 g921 g922 g923 g924 g925 g926 g927 g928 g929 g930 g931 g932 g933 g934 g935 g936 g937 g938 g939 g940 g941 g942 g943 g944 g945 g946 g947 g948 g949 g950 g951 g952 g953 g954 g955 g956 g957 g958 g959 g960 g961 g962 g963 g964 g965 g966 g967 g968 g969 g970 g971 g972 g973 g974 g975 g976 g977 g978 g979 g980 g981 g982 g983 g984 g985 g986 g987 g988 g989 g990 g991 g992 g993 g994 g995 g996 g997 g998 g999 g1000)
+      (+ g901 g902 g903 g904 g905 g906 g907 g908 g909 g910 g911 g912 g913 g914 g915 g916 g917 g918 g919 g920 g921 g922 g923 g924 g925 g926 g927 g928 g929 g930 g931 g932 g933 g934 g935 g936 g937 g938 g939 g940 g941 g942 g943 g944 g945 g946 g947 g948 g949 g950 g951 g952 g953 g954 g955 g956 g957 g958 g959 g960 g961 g962 g963 g964 g965 g966 g967 g968 g969 g970 g971 g972 g973 g974 g975 g976 g977 g978 g979 g980 g981 g982 g983 g984 g985 g986 g987 g988 g989 g990 g991 g992 g993 g994 g995 g996 g997 g998 g999 g1000)
+      (+ g901 g902 g903 g904 g905 g906 g907 g908 g909 g910 g911 g912 g913 g914 g915 g916 g917 g918 g919 g920 g921 g922 g923 g924 g925 g926 g927 g928 g929 g930 g931 g932 g933 g934 g935 g936 g937 g938 g939 g940 g941 g942 g943 g944 g945 g946 g947 g948 g949 g950 g951 g952 g953 g954 g955 g956 g957 g958 g959 g960 g961 g962 g963 g964 g965 g966 g967 g968 g969 g970 g971 g972 g973 g974 g975 g976 g977 g978 g979 g980 g981 g982 g983 g984 g985 g986 g987 g988 g989 g990 g991 g992 g993 g994 g995 g996 g997 g998 g999 g1000)
+      (+ g901 g902 g903 g904 g905 g906 g907 g908 g909 g910 g911 g912 g913 g914 g915 g916 g917 g918 g919 g920 g921 g922 g923 g924 g925 g926 g927 g928 g929 g930 g931 g932 g933 g934 g935 g936 g937 g938 g939 g940 g941 g942 g943 g944 g945 g946 g947 g948 g949 g950 g951 g952 g953 g954 g955 g956 g957 g958 g959 g960 g961 g962 g963 g964 g965 g966 g967 g968 g969 g970 g971 g972 g973 g974 g975 g976 g977 g978 g979 g980 g981 g982 g983 g984 g985 g986 g987 g988 g989 g990 g991 g992 g993 g994 g995 g996 g997 g998 g999 g1000)
+      (+ g901 g902 g903 g904 g905 g906 g907 g908 g909 g910 g911 g912 g913 g914 g915 g916 g917 g918 g919 g920 g921 g922 g923 g924 g925 g926 g927 g928 g929 g930 g931 g932 g933 g934 g935 g936 g937 g938 g939 g940 g941 g942 g943 g944 g945 g946 g947 g948 g949 g950 g951 g952 g953 g954 g955 g956 g957 g958 g959 g960 g961 g962 g963 g964 g965 g966 g967 g968 g969 g970 g971 g972 g973 g974 g975 g976 g977 g978 g979 g980 g981 g982 g983 g984 g985 g986 g987 g988 g989 g990 g991 g992 g993 g994 g995 g996 g997 g998 g999 g1000)}))
+(print (foldl + 0 (map f list-1k)))
@@ -0,0 +1,6 @@
+; Arithmetic on small numbers, each result of which used to be allocated (see `allocs`).
+(load "bench/data/list-1k.cl")
+
+(print (fib 18))
+(print (sum list-1k))
+(print (foldl - 0 list-1k))
@@ -0,0 +1,141 @@
+#!/bin/sh
+# Runs the benchmarks of bench/ (all of them, or those named) on clisp as built from the
+# working tree, and on each of the variants given as options, e.g.
+#
+#   $ bench/run.sh -r HEAD~1 numbers calls
+#
+# For each one, it reports the best wall-clock time of a few runs (including startup, i.e.
+# loading the prelude), the number of calls to malloc/calloc/realloc, and the peak resident
+# set size (see stats.c). Variants whose output differs from the working tree's are flagged.
+#
+# Every build runs from a directory of its own, with its prelude and a copy of bench/, in
+# which data/ holds generated scripts for the benchmarks to load: data/list-N.cl defines
+# `list-N`, a list of the numbers 1 to N (for N = 1k, 10k and 100k), data/mixed-100k.cl
+# defines `mixed-100k`, a list of 100k symbols, strings and lists (of a number), and
+# data/globals-N.cl defines N globals `g1` to `gN` (for N = 100, 1k and 10k).
+#
+# Options:
+#   -r REV      also benchmark revision REV (built from `git archive`)
+#   -D MACRO    also benchmark the working tree built with `-DMACRO`
+#   -f OPTION   also benchmark the working tree run with `OPTION` (e.g. --no-vm)
+#   -n RUNS     number of runs of each benchmark (3 by default)
+#
+# Set CC, CFLAGS and LDLIBS to build with other than `cc -O2` and editline.
+
+set -e
+
+repo=$(cd "$(dirname "$0")/.." && pwd)
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-}
+LDLIBS=${LDLIBS--ledit}
+
+runs=3
+variants=""
+while getopts "r:D:f:n:" opt; do
+    case $opt in
+        r) variants="$variants rev:$OPTARG" ;;
+        D) variants="$variants macro:$OPTARG" ;;
+        f) variants="$variants flag:$OPTARG" ;;
+        n) runs=$OPTARG ;;
+        *) exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+names="$*"
+if [ -z "$names" ]; then
+    names=$(cd "$repo/bench" && ls *.cl | sed 's/\.cl$//')
+fi
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+# Generated scripts.
+mkdir "$tmp/data"
+for n in 1000 10000 100000; do
+    echo "(def {list-$((n / 1000))k} {$(seq -s ' ' 1 $n)})" > "$tmp/data/list-$((n / 1000))k.cl"
+done
+seq 1 100000 | awk '
+    BEGIN { printf "(def {mixed-100k} {" }
+    { printf (NR % 3 == 0 ? "s%d " : NR % 3 == 1 ? "\"s%d\" " : "{%d} "), $1 }
+    END { print "})" }' > "$tmp/data/mixed-100k.cl"
+for n in 100 1000 10000; do
+    name=$n
+    if [ $n -ge 1000 ]; then name=$((n / 1000))k; fi
+    echo "(def {$(seq -s ' ' -f 'g%.0f' 1 $n)} $(seq -s ' ' 1 $n))" > "$tmp/data/globals-$name.cl"
+done
+
+# Builds clisp (from the sources in directory $1, with extra flags $2) in $1.
+build() {
+    mkdir -p "$1/bench"
+    cp "$repo/bench/"*.cl "$1/bench/"
+    cp -r "$tmp/data" "$1/bench/"
+    (cd "$1" && $CC -std=c99 -O2 $CFLAGS $2 $(ls *.c) ext/mpc.c "$repo/bench/stats.c" \
+        -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc -o clisp $LDLIBS)
+}
+
+# Copies the working tree (including uncommitted changes) to directory $1.
+copy_tree() {
+    mkdir -p "$1/ext"
+    cp "$repo/"*.c "$repo/"*.h "$repo/prelude.cl" "$1/"
+    cp "$repo/ext/"* "$1/ext/"
+}
+
+# Directory from which variant $1 runs.
+dir_of() {
+    case $1 in
+        rev:*|macro:*) echo "$tmp/$(echo "$1" | tr -c 'A-Za-z0-9_\n' '_')" ;;
+        *)             echo "$tmp/tree" ;;
+    esac
+}
+
+copy_tree "$tmp/tree"
+build "$tmp/tree" ""
+
+for variant in $variants; do
+    dir=$(dir_of "$variant")
+    case $variant in
+        rev:*)
+            mkdir -p "$dir"
+            git -C "$repo" archive "${variant#rev:}" | tar -x -C "$dir"
+            build "$dir" ""
+            ;;
+        macro:*)
+            copy_tree "$dir"
+            build "$dir" "-D${variant#macro:}"
+            ;;
+    esac
+done
+
+printf '%-14s %-26s %9s %12s %12s\n' benchmark build time allocs peak-rss
+for name in $names; do
+    for variant in tree $variants; do
+        dir=$(dir_of "$variant")
+        flag=""
+        case $variant in flag:*) flag=${variant#flag:} ;; esac
+
+        best=""
+        : > "$tmp/stats"
+        i=0
+        while [ $i -lt "$runs" ]; do
+            start=$(date +%s%N)
+            (cd "$dir" && CLISP_STATS="$tmp/stats" ./clisp $flag "bench/$name.cl" > "$tmp/out")
+            end=$(date +%s%N)
+            ms=$(((end - start) / 1000000))
+            if [ -z "$best" ] || [ $ms -lt "$best" ]; then best=$ms; fi
+            i=$((i + 1))
+        done
+
+        # Flag the variants whose output differs from that of the working tree.
+        note=""
+        if [ "$variant" = tree ]; then
+            cp "$tmp/out" "$tmp/expected"
+        elif ! cmp -s "$tmp/out" "$tmp/expected"; then
+            note="  (different output)"
+        fi
+
+        stats=$(tail -n 1 "$tmp/stats")
+        printf '%-14s %-26s %8.3fs %12s %9s kB%s\n' "$name" "$variant" \
+            "$(echo "$best" | awk '{ print $1 / 1000 }')" "${stats% *}" "${stats#* }" "$note"
+    done
+done
@@ -0,0 +1,46 @@
+// Counts the calls to malloc, calloc and realloc of a benchmarked build of clisp (which is
+// linked with `-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc`, see run.sh), and appends
+// them to the file named by $CLISP_STATS at exit, along with the peak resident set size.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static unsigned long allocs = 0;
+
+void *__wrap_malloc(size_t size) {
+    allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    allocs++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    allocs++;
+    return __real_realloc(ptr, size);
+}
+
+static void lstats_report(void) {
+    const char *path = getenv("CLISP_STATS");
+    if (!path) return;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    FILE *f = fopen(path, "a");
+    if (!f) return;
+    fprintf(f, "%lu %ld\n", allocs, usage.ru_maxrss); // (in kB on Linux)
+    fclose(f);
+}
+
+__attribute__((constructor))
+static void lstats_init(void) {
+    atexit(lstats_report);
+}
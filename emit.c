@@ -0,0 +1,625 @@
+#include "emit.h"
+#include "fold.h"
+#include "memo.h"
+#include "sym.h"
+#include "vm.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Writes `s` as a C string literal.
+static void lemit_str(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; ++s) {
+        const unsigned char c = *s;
+        switch (c) {
+            case '"':  fputs("\\\"", out); break;
+            case '\\': fputs("\\\\", out); break;
+            case '?':  fputs("\\?", out);  break; // (no trigraphs)
+            case '\n': fputs("\\n", out);  break;
+            case '\t': fputs("\\t", out);  break;
+            default:
+                if (c < ' ' || c > '~') fprintf(out, "\\%03o", c);
+                else                    fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Writes `x` as a C constant.
+static void lemit_long(FILE *out, const long x) {
+    if (x == LONG_MIN) fputs("LONG_MIN", out);
+    else               fprintf(out, "%liL", x);
+}
+
+// Writes an expression which creates the atom `v`.
+static void lemit_atom(FILE *out, const lval *v) {
+    switch (lval_type_of(v)) {
+        case LVAL_NUM:
+            fputs("lval_num(", out);
+            lemit_long(out, lval_num_of(v));
+            fputc(')', out);
+            break;
+
+        case LVAL_ERR: fputs("lval_err(\"%s\", ", out); lemit_str(out, v->err); fputc(')', out); break;
+        case LVAL_SYM: fputs("lval_sym(", out);         lemit_str(out, v->sym); fputc(')', out); break;
+        case LVAL_STR: fputs("lval_str(", out);         lemit_str(out, v->str); fputc(')', out); break;
+
+        default: assert(false);
+    }
+}
+
+// Writes the statements which create the list `v`, in local variable `v<var>` (and the
+// ones after it, for its nested lists). Returns the next unused variable.
+static int lemit_list(FILE *out, const lval *v, const int var) {
+    fprintf(
+        out, "        lval *v%i = lval_reserve(lval_%s(), %i);\n",
+        var, lval_type_of(v) == LVAL_QEXPR ? "qexpr" : "sexpr", v->cell_count
+    );
+
+    int next = var + 1;
+    for (int i = 0; i < v->cell_count; ++i) {
+        const lval *x = v->cell[i];
+        if (lval_type_of(x) == LVAL_SEXPR || lval_type_of(x) == LVAL_QEXPR) {
+            const int child = next;
+            next = lemit_list(out, x, child);
+            fprintf(out, "        lval_add(v%i, v%i);\n", var, child);
+        } else {
+            fprintf(out, "        lval_add(v%i, ", var);
+            lemit_atom(out, x);
+            fputs(");\n", out);
+        }
+    }
+
+    return next;
+}
+
+//
+// Native functions.
+//
+
+// A top-level definition `(fun {name formals...} {body})` which is translated to native
+// functions (see emit.h), `lnat_<index>` and the ones it's made of.
+typedef struct lemit_fun {
+    const lval  *def;      // `{name formals...}`
+    const lval  *body;
+    bool        ops[LOP_COUNT]; // built-ins called by it (or by the functions it calls)
+    bool        *calls;    // likewise for the native functions (by index, itself included)
+} lemit_fun;
+
+typedef struct lemit_natives {
+    int         count;
+    int         capacity;
+    lemit_fun   *funs;
+} lemit_natives;
+
+// Returns the index of the formal `sym` of `f`, or -1.
+static int lemit_formal_of(const lemit_fun *f, const char *sym) {
+    for (int i = 1; i < f->def->cell_count; ++i)
+        if (f->def->cell[i]->sym == sym) return i - 1;
+    return -1;
+}
+
+// Returns the index of the native function named `sym` when `f` was defined (i.e. the
+// latest one up to `f` itself), or -1.
+static int lemit_native_of(const lemit_natives *n, const lemit_fun *f, const char *sym) {
+    for (int i = f - n->funs; i >= 0; --i)
+        if (n->funs[i].def->cell[0]->sym == sym) return i;
+    return -1;
+}
+
+// Returns the opcode of the arithmetic, comparison or `if` built-in named `sym`, or -1.
+static int lemit_op_of(const char *sym) {
+    static const LOP ops[] = {
+        LOP_ADD, LOP_SUB, LOP_MUL, LOP_DIV, LOP_LT, LOP_GT, LOP_LE, LOP_GE, LOP_EQ, LOP_NE, LOP_IF
+    };
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i)
+        if (!strcmp(lop_names[ops[i]], sym)) return ops[i];
+    return -1;
+}
+
+static bool lemit_is_native_list(lemit_natives *n, lemit_fun *f, const lval *v);
+
+// Whether `v` (in the body of `f`, the last of `n`) computes a number that a native function
+// can, i.e. whether it's a number, a formal, or an expression made of those.
+static bool lemit_is_native(lemit_natives *n, lemit_fun *f, const lval *v) {
+    switch (lval_type_of(v)) {
+        case LVAL_NUM:   return true;
+        case LVAL_SYM:   return lemit_formal_of(f, v->sym) >= 0;
+        case LVAL_SEXPR: return lemit_is_native_list(n, f, v);
+        default:         return false;
+    }
+}
+
+// Likewise for the cells of `v`, evaluated as an S-Expression: a single expression, a call
+// to a native function on as many arguments as it takes, arithmetic or comparisons (on as
+// many arguments as the built-ins take), or an `if` on literal branches.
+static bool lemit_is_native_list(lemit_natives *n, lemit_fun *f, const lval *v) {
+    if (v->cell_count == 0) return false;
+    if (v->cell_count == 1) return lemit_is_native(n, f, v->cell[0]);
+
+    const lval *k = v->cell[0];
+    if (lval_type_of(k) != LVAL_SYM || lemit_formal_of(f, k->sym) >= 0) return false;
+
+    const int callee = lemit_native_of(n, f, k->sym);
+    if (callee >= 0) {
+        if (v->cell_count != n->funs[callee].def->cell_count) return false;
+        for (int i = 1; i < v->cell_count; ++i)
+            if (!lemit_is_native(n, f, v->cell[i])) return false;
+
+        // (It calls whatever that function does, and that function itself.)
+        const lemit_fun *g = &n->funs[callee];
+        for (int i = 0; i < LOP_COUNT; ++i) f->ops[i] |= g->ops[i];
+        for (int i = 0; i < callee; ++i) f->calls[i] |= g->calls[i];
+        f->calls[callee] = true;
+        return true;
+    }
+
+    const int op = lemit_op_of(k->sym);
+    switch (op) {
+        case LOP_ADD: case LOP_SUB: case LOP_MUL: case LOP_DIV:
+            break;
+
+        case LOP_LT: case LOP_GT: case LOP_LE: case LOP_GE: case LOP_EQ: case LOP_NE:
+            if (v->cell_count != 3) return false;
+            break;
+
+        case LOP_IF:
+            if (v->cell_count != 4 || !lemit_is_native(n, f, v->cell[1])) return false;
+            for (int i = 2; i <= 3; ++i) {
+                if (lval_type_of(v->cell[i]) != LVAL_QEXPR) return false;
+                if (!lemit_is_native_list(n, f, v->cell[i])) return false;
+            }
+            f->ops[op] = true;
+            return true;
+
+        default:
+            return false;
+    }
+
+    for (int i = 1; i < v->cell_count; ++i)
+        if (!lemit_is_native(n, f, v->cell[i])) return false;
+    f->ops[op] = true;
+    return true;
+}
+
+// Adds the definition `form` to the native functions `n`, if it can be translated to one.
+// Its formals mustn't be the names of what it calls, since (as scope is dynamic) they would
+// shadow them in the functions it calls too.
+static bool lemit_add_native(lemit_natives *n, const lval *form) {
+    if (lval_type_of(form) != LVAL_SEXPR || form->cell_count != 3) return false;
+    if (lval_type_of(form->cell[0]) != LVAL_SYM || strcmp(form->cell[0]->sym, "fun")) return false;
+
+    const lval *def = form->cell[1];
+    if (lval_type_of(def) != LVAL_QEXPR || def->cell_count == 0) return false;
+    for (int i = 0; i < def->cell_count; ++i) {
+        if (lval_type_of(def->cell[i]) != LVAL_SYM || lval_is_rest(def->cell[i])) return false;
+        if (i > 0 && lemit_formal_of(&(lemit_fun){ .def = def }, def->cell[i]->sym) < i - 1)
+            return false; // (bound twice)
+    }
+    if (lval_type_of(form->cell[2]) != LVAL_QEXPR) return false;
+
+    if (n->count == n->capacity) {
+        n->capacity = n->capacity ? 2 * n->capacity : 8;
+        n->funs = realloc(n->funs, n->capacity * sizeof(lemit_fun));
+    }
+
+    // Add it first, so that it can call itself.
+    lemit_fun *f = &n->funs[n->count++];
+    *f = (lemit_fun){ .def = def, .body = form->cell[2], .calls = calloc(n->count, sizeof(bool)) };
+
+    bool native = lemit_is_native_list(n, f, f->body);
+    for (int i = 1; native && i < def->cell_count; ++i) {
+        const char *formal = def->cell[i]->sym;
+        for (int op = 0; op < LOP_COUNT; ++op)
+            if (f->ops[op] && !strcmp(lop_names[op], formal)) native = false;
+        for (int j = 0; j < n->count; ++j)
+            if (f->calls[j] && n->funs[j].def->cell[0]->sym == formal) native = false;
+    }
+
+    if (!native) {
+        free(f->calls);
+        n->count--;
+    }
+    return native;
+}
+
+static void lemit_native_list(FILE *out, const lemit_natives *n, const lemit_fun *f, const lval *v);
+
+// Writes the C expression (of type `long`) which computes `v` (see `lemit_is_native`).
+static void lemit_native(FILE *out, const lemit_natives *n, const lemit_fun *f, const lval *v) {
+    switch (lval_type_of(v)) {
+        case LVAL_NUM:   lemit_long(out, lval_num_of(v));                    break;
+        case LVAL_SYM:   fprintf(out, "x%i", lemit_formal_of(f, v->sym));    break;
+        case LVAL_SEXPR: lemit_native_list(out, n, f, v);                    break;
+        default:         assert(false);
+    }
+}
+
+static void lemit_native_list(FILE *out, const lemit_natives *n, const lemit_fun *f, const lval *v) {
+    if (v->cell_count == 1) {
+        lemit_native(out, n, f, v->cell[0]);
+        return;
+    }
+
+    const int callee = lemit_native_of(n, f, v->cell[0]->sym);
+    if (callee >= 0) {
+        fprintf(out, "lnat_%i(", callee);
+        for (int i = 1; i < v->cell_count; ++i) {
+            if (i > 1) fputs(", ", out);
+            lemit_native(out, n, f, v->cell[i]);
+        }
+        fputc(')', out);
+        return;
+    }
+
+    const int op = lemit_op_of(v->cell[0]->sym);
+    switch (op) {
+        case LOP_IF:
+            fputc('(', out);
+            lemit_native(out, n, f, v->cell[1]);
+            fputs(" ? ", out);
+            lemit_native_list(out, n, f, v->cell[2]);
+            fputs(" : ", out);
+            lemit_native_list(out, n, f, v->cell[3]);
+            fputc(')', out);
+            break;
+
+        case LOP_DIV:
+            // (Which fails on a division by zero, see `lnat_div`.)
+            for (int i = 2; i < v->cell_count; ++i) fputs("lnat_div(", out);
+            lemit_native(out, n, f, v->cell[1]);
+            for (int i = 2; i < v->cell_count; ++i) {
+                fputs(", ", out);
+                lemit_native(out, n, f, v->cell[i]);
+                fputc(')', out);
+            }
+            break;
+
+        default: {
+            // `-` on a single argument negates it (and the others return it as is).
+            if (v->cell_count == 2) {
+                fputs(op == LOP_SUB ? "(-(" : "((", out);
+                lemit_native(out, n, f, v->cell[1]);
+                fputs("))", out);
+                break;
+            }
+
+            const char *c_ops[LOP_COUNT] = {
+                [LOP_ADD] = "+", [LOP_SUB] = "-", [LOP_MUL] = "*",
+                [LOP_LT] = "<", [LOP_GT] = ">", [LOP_LE] = "<=", [LOP_GE] = ">=",
+                [LOP_EQ] = "==", [LOP_NE] = "!="
+            };
+            const bool cmp = op != LOP_ADD && op != LOP_SUB && op != LOP_MUL;
+            fputs(cmp ? "(long)(" : "(", out);
+            for (int i = 1; i < v->cell_count; ++i) {
+                if (i > 1) fprintf(out, " %s ", c_ops[op]);
+                lemit_native(out, n, f, v->cell[i]);
+            }
+            fputc(')', out);
+            break;
+        }
+    }
+}
+
+// Whether `f` calls itself in tail position in the list `v` (see `lemit_native_tail`).
+static bool lemit_native_loops(const lemit_natives *n, const lemit_fun *f, const lval *v) {
+    if (v->cell_count == 1 && lval_type_of(v->cell[0]) == LVAL_SEXPR)
+        return lemit_native_loops(n, f, v->cell[0]);
+    if (v->cell_count == 1) return false;
+
+    if (v->cell_count == 4 && lemit_native_of(n, f, v->cell[0]->sym) < 0
+        && lemit_op_of(v->cell[0]->sym) == LOP_IF)
+        return lemit_native_loops(n, f, v->cell[2]) || lemit_native_loops(n, f, v->cell[3]);
+    return lemit_native_of(n, f, v->cell[0]->sym) == f - n->funs;
+}
+
+static void lemit_indent(FILE *out, const int depth) {
+    for (int i = 0; i < depth; ++i) fputs("    ", out);
+}
+
+// Writes the statements which return the value of the list `v` in tail position of the
+// body of `f`. The branches of an `if` become statements, and calls of `f` to itself
+// become jumps back to its start (with its formals updated).
+static void lemit_native_tail(FILE *out, const lemit_natives *n, const lemit_fun *f, const lval *v,
+                              const int depth) {
+    if (v->cell_count == 1 && lval_type_of(v->cell[0]) == LVAL_SEXPR) {
+        lemit_native_tail(out, n, f, v->cell[0], depth);
+        return;
+    }
+
+    if (v->cell_count == 4 && lemit_native_of(n, f, v->cell[0]->sym) < 0
+        && lemit_op_of(v->cell[0]->sym) == LOP_IF) {
+        lemit_indent(out, depth);
+        fputs("if (", out);
+        lemit_native(out, n, f, v->cell[1]);
+        fputs(") {\n", out);
+        lemit_native_tail(out, n, f, v->cell[2], depth + 1);
+        lemit_indent(out, depth);
+        fputs("} else {\n", out);
+        lemit_native_tail(out, n, f, v->cell[3], depth + 1);
+        lemit_indent(out, depth);
+        fputs("}\n", out);
+        return;
+    }
+
+    if (v->cell_count > 1 && lemit_native_of(n, f, v->cell[0]->sym) == f - n->funs) {
+        // (Every argument is computed before any formal is updated.)
+        for (int i = 1; i < v->cell_count; ++i) {
+            lemit_indent(out, depth);
+            fprintf(out, "const long y%i = ", i - 1);
+            lemit_native(out, n, f, v->cell[i]);
+            fputs(";\n", out);
+        }
+        for (int i = 1; i < v->cell_count; ++i) {
+            lemit_indent(out, depth);
+            fprintf(out, "x%i = y%i;\n", i - 1, i - 1);
+        }
+        lemit_indent(out, depth);
+        fputs("if (lnat_failed) return 0;\n", out);
+        lemit_indent(out, depth);
+        fputs("goto start;\n", out);
+        return;
+    }
+
+    lemit_indent(out, depth);
+    fputs("return ", out);
+    lemit_native_list(out, n, f, v);
+    fputs(";\n", out);
+}
+
+// Writes the formals of `f` as the parameters of a C function.
+static void lemit_params(FILE *out, const lemit_fun *f) {
+    fputc('(', out);
+    for (int i = 1; i < f->def->cell_count; ++i) fprintf(out, "%slong x%i", i > 1 ? ", " : "", i - 1);
+    if (f->def->cell_count == 1) fputs("void", out);
+    fputc(')', out);
+}
+
+// Writes the native functions for `f`: `lnat_<i>_body`, which computes its body, `lnat_<i>`,
+// which limits the depth of native calls, and `lnat_<i>_call`, which is called instead of
+// `f` by Lisp code (see `lnative`).
+static void lemit_native_fun(FILE *out, const lemit_natives *n, const int i) {
+    const lemit_fun *f = &n->funs[i];
+    const int arity = f->def->cell_count - 1;
+
+    fputs("// ", out);
+    lemit_str(out, f->def->cell[0]->sym);
+    fprintf(out, "\nstatic long lnat_%i_body", i);
+    lemit_params(out, f);
+    fputs(lemit_native_loops(n, f, f->body) ? " {\nstart:\n" : " {\n", out);
+    lemit_native_tail(out, n, f, f->body, 1);
+    fputs("}\n\n", out);
+
+    fprintf(out, "static long lnat_%i", i);
+    lemit_params(out, f);
+    fprintf(out, " {\n    if (!lnat_enter()) return 0;\n\n    const long x = lnat_%i_body(", i);
+    for (int j = 0; j < arity; ++j) fprintf(out, "%sx%i", j ? ", " : "", j);
+    fputs(");\n    lnat_depth--;\n    return x;\n}\n\n", out);
+
+    // The call is only made natively while every name it refers to (transitively) is still
+    // bound to what it was translated for.
+    fprintf(out, "static lval *lnat_%i_call(lval *const *args, const int count) {\n", i);
+    fprintf(out, "    if (!lnat_can_call(args, count, %i)) return NULL;\n", arity);
+    for (int op = 0; op < LOP_COUNT; ++op) {
+        if (!f->ops[op]) continue;
+        fprintf(out, "    if (lsym_builtin(lnat_ops[%i]) != %i) return NULL; // ", op, op);
+        lemit_str(out, lop_names[op]);
+        fputc('\n', out);
+    }
+    for (int j = 0; j <= i; ++j) {
+        if (!f->calls[j]) continue;
+        fprintf(out, "    if (!lemit_bound(lnat_env, lnat_names[%i], lnat_%i_call)) return NULL;\n", j, j);
+    }
+    fprintf(out, "\n    const long x = lnat_%i(", i);
+    for (int j = 0; j < arity; ++j) fprintf(out, "%slval_num_of(args[%i])", j ? ", " : "", j);
+    fputs(");\n    return lnat_failed ? NULL : lval_num(x);\n}\n\n", out);
+}
+
+// Writes the native functions `n`, and the state they share.
+static void lemit_natives_of(FILE *out, const lemit_natives *n) {
+    fputs("// Native functions (see `lemit_install`).\n", out);
+    fputs("static lenv *lnat_env;\n", out);
+    fputs("static const char *lnat_ops[LOP_COUNT]; // (names of the built-ins, interned)\n", out);
+    fprintf(out, "static lval *lnat_names[%i];\n", n->count);
+    fputs("static bool lnat_failed; // (if the call can't be made natively after all)\n", out);
+    fputs("static int lnat_depth;\n", out);
+    fputs("static int lnat_frames = INT_MAX; // (see `lnat_can_call`)\n\n", out);
+
+    fputs("// Whether a native function can be called (one level deeper), in which case it is.\n", out);
+    fputs("static bool lnat_enter(void) {\n", out);
+    fputs("    if (lnat_failed) return false;\n", out);
+    fputs("    if (lnat_depth < LVAL_MAX_NATIVE_DEPTH) {\n", out);
+    fputs("        lnat_depth++;\n        return true;\n    }\n\n", out);
+    fputs("    lnat_failed = true;\n", out);
+    fputs("    lnat_frames = lenv_frame_top;\n", out);
+    fputs("    return false;\n}\n\n", out);
+
+    fputs("// Whether a native function on `arity` numbers can be called on `args`.\n", out);
+    fputs("static bool lnat_can_call(lval *const *args, const int count, const int arity) {\n", out);
+    fputs("    if (count != arity) return false;\n", out);
+    fputs("    for (int i = 0; i < count; ++i)\n", out);
+    fputs("        if (lval_type_of(args[i]) != LVAL_NUM) return false;\n\n", out);
+    fputs("    // Once a call has been too deep to be made natively, the ones it then makes as it's\n", out);
+    fputs("    // evaluated (in deeper frames) would be too, so they aren't tried before it returns.\n", out);
+    fputs("    if (lenv_frame_top > lnat_frames) return false;\n", out);
+    fputs("    lnat_frames = INT_MAX;\n", out);
+    fputs("    lnat_failed = false;\n", out);
+    fputs("    return true;\n}\n\n", out);
+
+    bool div = false;
+    for (int i = 0; i < n->count; ++i) div |= n->funs[i].ops[LOP_DIV];
+    if (div) {
+        fputs("static long lnat_div(const long x, const long y) {\n", out);
+        fputs("    if (y) return x / y;\n", out);
+        fputs("    lnat_failed = true; // (so that the error is reported as usual)\n", out);
+        fputs("    return 0;\n}\n\n", out);
+    }
+
+    // (Declared first, since they may call each other.)
+    for (int i = 0; i < n->count; ++i) {
+        fprintf(out, "static long lnat_%i", i);
+        lemit_params(out, &n->funs[i]);
+        fputs(";\n", out);
+    }
+    fputc('\n', out);
+
+    for (int i = 0; i < n->count; ++i) lemit_native_fun(out, n, i);
+}
+
+//
+// Program.
+//
+
+// Writes a function `forms_<i>_<j>` which creates the top-level expressions `forms` from
+// `start` (inclusive) to `end` (exclusive).
+static void lemit_forms(FILE *out, const int i, const int j, const char *path, const lval *forms,
+                        const int start, const int end) {
+    fprintf(out, "// ");
+    lemit_str(out, path);
+    fprintf(out, "\nstatic lval *forms_%i_%i(void) {\n", i, j);
+    fprintf(out, "    lval *forms = lval_reserve(lval_sexpr(), %i);\n", end - start);
+
+    // Each expression is created in its own block, so that variables don't pile up.
+    for (int k = start; k < end; ++k) {
+        const lval *x = forms->cell[k];
+        fputs("    {\n", out);
+        if (lval_type_of(x) == LVAL_SEXPR || lval_type_of(x) == LVAL_QEXPR) {
+            lemit_list(out, x, 0);
+            fputs("        lval_add(forms, v0);\n", out);
+        } else {
+            fputs("        lval_add(forms, ", out);
+            lemit_atom(out, x);
+            fputs(");\n", out);
+        }
+        fputs("    }\n", out);
+    }
+
+    fputs("    return forms;\n}\n\n", out);
+}
+
+lval *lemit_program(FILE *out, char *const *paths, const int count) {
+    // Read every file first, so that nothing is written if one of them can't be.
+    lval *files = lval_reserve(lval_sexpr(), count);
+    for (int i = 0; i < count; ++i) {
+        lval *forms = lval_read_file(paths[i]);
+        if (lval_type_of(forms) == LVAL_ERR) {
+            lval_free(files);
+            return forms;
+        }
+        lval_add(files, forms);
+    }
+
+    // The forms of each file are split after each definition of a native function, which is
+    // installed once it's evaluated: `natives[i][j]` is the one which ends chunk `j` of file
+    // `i` (or -1 if it's the last chunk, which doesn't).
+    lemit_natives n = { 0 };
+    int **natives = malloc(count * sizeof(int *));
+    int *chunks = malloc(count * sizeof(int));
+    for (int i = 0; i < count; ++i) {
+        const lval *forms = files->cell[i];
+        natives[i] = malloc((forms->cell_count + 1) * sizeof(int));
+        chunks[i] = 0;
+        for (int j = 0; j < forms->cell_count; ++j)
+            if (lemit_add_native(&n, forms->cell[j])) natives[i][chunks[i]++] = n.count - 1;
+        natives[i][chunks[i]++] = -1;
+    }
+
+    fputs("// Generated by `clisp --emit-c`.\n\n", out);
+    fputs("#include \"emit.h\"\n#include \"fold.h\"\n#include \"lval.h\"\n#include \"memo.h\"\n", out);
+    fputs("#include \"sym.h\"\n#include \"vm.h\"\n\n", out);
+    fputs("#include <limits.h>\n\n", out);
+
+    if (n.count) lemit_natives_of(out, &n);
+
+    for (int i = 0; i < count; ++i) {
+        const lval *forms = files->cell[i];
+        for (int j = 0, start = 0; j < chunks[i]; ++j) {
+            int end = forms->cell_count;
+            if (natives[i][j] >= 0) {
+                end = start;
+                while (forms->cell[end]->cell[1] != n.funs[natives[i][j]].def) end++;
+                end++;
+            }
+            lemit_forms(out, i, j, paths[i], forms, start, end);
+            start = end;
+        }
+    }
+
+    fputs("int main(void) {\n", out);
+    fputs("    // (Only needed to `load` other files.)\n    lval_parser_new();\n\n", out);
+    if (!lfold_enabled)     fputs("    lfold_enabled = false;\n", out);
+    if (!lvm_enabled)       fputs("    lvm_enabled = false;\n", out);
+    if (lmemo_auto)         fputs("    lmemo_auto = true;\n", out);
+    if (!lval_native_lists) fputs("    lval_native_lists = false;\n", out);
+    fputs("    lenv *e = lenv_new();\n    lenv_add_builtins(e);\n\n", out);
+    if (n.count) {
+        fputs("    lnat_env = e;\n", out);
+        fputs("    for (int i = 0; i < LOP_COUNT; ++i) lnat_ops[i] = lsym_intern(lop_names[i]);\n", out);
+        for (int i = 0; i < n.count; ++i) {
+            fprintf(out, "    lnat_names[%i] = lval_sym(", i);
+            lemit_str(out, n.funs[i].def->cell[0]->sym);
+            fputs(");\n", out);
+        }
+        fputc('\n', out);
+    }
+    for (int i = 0; i < count; ++i) {
+        for (int j = 0; j < chunks[i]; ++j) {
+            const int k = natives[i][j];
+            if (k < 0) {
+                fprintf(out, "    lval_eval_forms(e, forms_%i_%i());\n", i, j);
+                continue;
+            }
+            fprintf(out, "    {\n        lval *forms = forms_%i_%i();\n", i, j);
+            fputs("        lval *def = lval_copy(forms->cell[forms->cell_count - 1]);\n", out);
+            fputs("        lval_eval_forms(e, forms);\n", out);
+            fprintf(out, "        lemit_install(e, def, lnat_%i_call);\n", k);
+            fputs("        lval_free(def);\n    }\n", out);
+        }
+        if (i == 0) fputs("    lenv_add_list_builtins(e);\n", out); // (after the prelude)
+    }
+    fputs("\n", out);
+    for (int i = 0; i < n.count; ++i) fprintf(out, "    lval_free(lnat_names[%i]);\n", i);
+    fputs("    lmemo_clear();\n    lenv_free(e);\n    lval_parser_delete();\n    return 0;\n}\n", out);
+
+    for (int i = 0; i < n.count; ++i) free(n.funs[i].calls);
+    free(n.funs);
+    for (int i = 0; i < count; ++i) free(natives[i]);
+    free(natives);
+    free(chunks);
+    lval_free(files);
+    return lval_sexpr();
+}
+
+//
+// Runtime support.
+//
+
+void lemit_install(lenv *e, lval *def, const lnative native) {
+    const lval *formals = def->cell[1];
+    lval *f = lenv_get(e, formals->cell[0]);
+
+    // It must be the lambda `def` defines, i.e. as `fun` would, with the same formals.
+    bool same = lval_type_of(f) == LVAL_FUN && !f->builtin && !f->env->count
+        && f->formals->cell_count == formals->cell_count - 1
+        && lval_equals(f->body, def->cell[2]);
+    for (int i = 0; same && i < f->formals->cell_count; ++i)
+        same = f->formals->cell[i]->sym == formals->cell[i + 1]->sym;
+
+    if (same) {
+        if (!f->body->code) f->body->code = calloc(1, sizeof(lcode));
+        f->body->code->native = native;
+    }
+    lval_free(f);
+}
+
+bool lemit_bound(lenv *e, lval *k, const lnative native) {
+    if (lsym_bindings(k->sym) != 1) return false;
+
+    lval *f = lenv_get(e, k);
+    const bool bound = lval_type_of(f) == LVAL_FUN && !f->builtin && lcode_native(f->body) == native;
+    lval_free(f);
+    return bound;
+}
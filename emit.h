@@ -0,0 +1,39 @@
+#ifndef __CLISP_EMIT_H__
+#define __CLISP_EMIT_H__
+
+#include <stdio.h>
+
+#include "lval.h"
+#include "vm.h"
+
+// Ahead-of-time translation of Lispy files to C (see `--emit-c`).
+//
+// The generated program links against the runtime (every source file but main.c), and
+// evaluates the top-level expressions of each file in turn, as `clisp` would load them.
+// These are built directly by the program, instead of being read and parsed when it starts
+// (so it doesn't need the files anymore either). They're then folded, and lambda bodies
+// compiled, as usual.
+//
+// Functions defined at the top level as `(fun {name formals...} {body})` whose body only
+// does arithmetic and comparisons on numbers, branches with `if` (on literal branches) and
+// calls such functions (or itself) are also translated to C functions on `long`s, which
+// call each other directly, with self tail calls as loops. Calls to them from Lisp code are
+// made natively (see `lnative`) while the names they use are still bound to the built-ins
+// and functions they were translated for, and their arguments are numbers. Otherwise, or
+// if one of them would fail (e.g. on a division by zero), they're simply evaluated.
+
+// Writes the program which evaluates the files `paths` (in order, starting with the prelude)
+// to `out`.
+// Returns an error if any of them can't be read, else an empty S-Expression.
+lval *lemit_program(FILE *out, char *const *paths, const int count);
+
+// Used by generated programs.
+
+// Makes calls to the function that `def` (the definition `(fun {name formals...} {body})`,
+// just evaluated in `e`) bound to `name` native, unless that's since been bound to another.
+void lemit_install(lenv *e, lval *def, const lnative native);
+
+// Whether the symbol `k` is bound (only) to a function made native by `native`, in `e`.
+bool lemit_bound(lenv *e, lval *k, const lnative native);
+
+#endif // __CLISP_EMIT_H__
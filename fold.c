@@ -0,0 +1,95 @@
+#include "fold.h"
+#include "sym.h"
+
+lfold_stats lfold = { 0 };
+bool lfold_enabled = true;
+
+// Returns (a copy of) the global value of a constant, or NULL if `k` isn't one.
+// Constants can't be rebound, so the global value is the only one they ever have.
+static lval *lfold_const(lenv *e, lval *k) {
+    if (lval_type_of(k) != LVAL_SYM || !lsym_is_const(k->sym)) return NULL;
+
+    lval *v = lenv_get(e->global_ref ? e->global_ref : e, k);
+    if (lval_type_of(v) == LVAL_ERR) {
+        lval_free(v);
+        return NULL;
+    }
+    return v;
+}
+
+static bool lfold_is_literal(const lval *v) {
+    switch (lval_type_of(v)) {
+        case LVAL_NUM:
+        case LVAL_STR:
+        case LVAL_QEXPR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Folds each of the cells of a list.
+static lval *lfold_cells(lenv *e, lval *v) {
+    lval *x = lval_reserve(v->type == LVAL_QEXPR ? lval_qexpr() : lval_sexpr(), v->cell_count);
+    while (v->cell_count) lval_add(x, lfold_expr(e, lval_pop(v, 0)));
+
+    lval_free(v);
+    return x;
+}
+
+lval *lfold_expr(lenv *e, lval *v) {
+    if (!lfold_enabled) return v;
+
+    switch (lval_type_of(v)) {
+        case LVAL_SYM: {
+            lval *x = lfold_const(e, v);
+            if (!x) return v;
+
+            // Functions aren't inlined, so that they're still printed by name.
+            if (lval_type_of(x) == LVAL_FUN) {
+                lval_free(x);
+                return v;
+            }
+
+            lval_free(v);
+            lfold.inlined++;
+            return x;
+        }
+
+        case LVAL_SEXPR:
+            return lfold_cells(e, v);
+
+        default:
+            return v;
+    }
+}
+
+lval *lfold_body(lenv *e, lval *body) {
+    if (!lfold_enabled) return body;
+
+    // The body is evaluated as an S-Expression, so it's folded like one.
+    body->type = LVAL_SEXPR;
+    lval *x = lfold_cells(e, body);
+    x->type = LVAL_QEXPR;
+    return x;
+}
+
+lval *lfold_call(lenv *e, const LOP op, lval *v) {
+    if (!lfold_enabled || !lop_pure[op]) return NULL;
+
+    for (int i = 1; i < v->cell_count; ++i) {
+        if (!lfold_is_literal(v->cell[i])) return NULL;
+    }
+
+    // Errors are left to be reported when (and if) the call is actually evaluated.
+    lval *a = lval_copy(v);
+    lval_free(lval_pop(a, 0));
+    lval *x = lop_funs[op](e, a);
+    if (!lval_is_imm(x)) {
+        lval_free(x);
+        return NULL;
+    }
+
+    lfold.folded++;
+    return x;
+}
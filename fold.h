@@ -0,0 +1,39 @@
+#ifndef __CLISP_FOLD_H__
+#define __CLISP_FOLD_H__
+
+#include "lval.h"
+
+// A constant folding (and partial evaluation) pass, run over loaded code and over the
+// bodies of lambdas when they're created.
+//
+// It replaces constants (symbols defined with `const`, e.g. `nil` and `true`) by their
+// values, since they can't be rebound. Q-Expressions are data, so they're left untouched,
+// except for lambda bodies. The names of built-in functions can be rebound, though (even
+// as the formals of a function, which then shadow them in whatever it calls), so calls to
+// them can only be folded where what they call is checked first: the virtual machine
+// folds calls to pure built-ins on literal arguments with `lfold_call` when it compiles
+// them, behind such a check (and likewise for `if`s on a literal condition).
+
+typedef struct lfold_stats {
+    unsigned long folded;  // calls replaced by their result
+    unsigned long inlined; // constants replaced by their value
+} lfold_stats;
+
+extern lfold_stats lfold;
+
+// Whether the pass is run at all (on by default, see `--no-fold`).
+extern bool lfold_enabled;
+
+// Folds an expression, as evaluated in `e`. Takes ownership of `v`.
+lval *lfold_expr(lenv *e, lval *v);
+
+// Folds the body of a lambda (a Q-Expression, which is evaluated as an S-Expression).
+// Takes ownership of `body`, and always returns a Q-Expression.
+lval *lfold_body(lenv *e, lval *body);
+
+// Returns the result of the call `v` to the pure built-in function `op` (which must be
+// what it calls), if all of its arguments are literals and it's an immediate number (so
+// that it can be embedded in compiled code as is), or NULL.
+lval *lfold_call(lenv *e, const LOP op, lval *v);
+
+#endif // __CLISP_FOLD_H__
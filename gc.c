@@ -0,0 +1,224 @@
+#include "gc.h"
+#include "mem.h"
+#include "memo.h"
+#include "sym.h"
+#include "vm.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+lgc_stats lgc = { 0 };
+
+// Number of allocations when the last collection happened.
+static unsigned long last_allocs = 0;
+
+static unsigned long lgc_allocs(void) {
+    return lval_pool.allocs + lenv_pool.allocs;
+}
+
+//
+// Mark.
+//
+
+static void lgc_mark_env(lenv *e);
+
+static void lgc_mark(lval *v) {
+    if (lval_is_imm(v) || !lpool_mark(v)) return;
+
+    switch (v->type) {
+        case LVAL_FUN:
+            if (!v->builtin) {
+                lgc_mark_env(v->env);
+                lgc_mark(v->formals);
+                lgc_mark(v->body);
+            }
+            break;
+
+        case LVAL_SEXPR:
+        case LVAL_QEXPR:
+            // Note that the whole storage is marked, not only the slice used by `v`.
+            if (v->store) {
+                for (int i = v->store->start; i < v->store->count; ++i)
+                    lgc_mark(v->store->cell[i]);
+            }
+            break;
+
+        default: break;
+    }
+}
+
+static void lgc_mark_env(lenv *e) {
+    // Note that `caller_ref` is not followed, as it only refers to an environment
+    // while a function is called (i.e. to the global environment or to a frame).
+    if (!lpool_mark(e)) return;
+
+    for (int i = 0; i < e->count; ++i)
+        lgc_mark(e->vals[i]);
+
+    if (e->parent_ref) lgc_mark_env(e->parent_ref);
+}
+
+//
+// Sweep.
+//
+
+// Unmarked objects that are in use.
+typedef struct lgc_garbage {
+    void    **objects;
+    int     count;
+    int     capacity;
+} lgc_garbage;
+
+static void lgc_gather(void *x, void *ctx) {
+    lgc_garbage *g = ctx;
+    if (g->count == g->capacity) {
+        g->capacity = g->capacity ? 2 * g->capacity : 256;
+        g->objects = realloc(g->objects, g->capacity * sizeof(void *));
+    }
+    g->objects[g->count++] = x;
+}
+
+static bool lgc_is_garbage(const lval *v) {
+    return !lval_is_imm(v) && !lpool_is_marked(v);
+}
+
+// Drops a reference held by garbage, unless `v` is garbage too
+// (in which case it will be deleted by the sweep, as is).
+static void lgc_release(lval *v) {
+    if (!lgc_is_garbage(v)) lval_free(v);
+}
+
+// Drops the references that the garbage value `v` holds onto live values.
+static void lgc_release_refs(lval *v) {
+    switch (v->type) {
+        case LVAL_FUN:
+            // Note that the environment is only referenced by its function.
+            if (!v->builtin) {
+                lgc_release(v->formals);
+                lgc_release(v->body);
+            }
+            break;
+
+        case LVAL_SEXPR:
+        case LVAL_QEXPR:
+            // The cells might still be shared with a live copy of `v`.
+            if (v->store && --(v->store->refs) == 0) {
+                for (int i = v->store->start; i < v->store->count; ++i)
+                    lgc_release(v->store->cell[i]);
+
+                const int slots = LCELLS_HEADER + v->store->capacity;
+                lcells_resize(v->store, slots, 0);
+                lgc.bytes_reclaimed += slots * sizeof(lval *);
+            }
+            break;
+
+        default: break;
+    }
+}
+
+static void lgc_sweep_lval(lval *v) {
+    switch (v->type) {
+        case LVAL_ERR:
+        case LVAL_STR:
+            if (lval_str_is_long(v)) {
+                lgc.bytes_reclaimed += v->len + 1;
+                free(v->str);
+            }
+            break;
+
+        case LVAL_SEXPR:
+        case LVAL_QEXPR:
+            if (v->code) {
+                lgc.bytes_reclaimed += lcode_size(v->code);
+                free(v->code);
+            }
+            break;
+
+        default: break;
+    }
+
+    lgc.bytes_reclaimed += lval_pool.size;
+    lpool_free(&lval_pool, v);
+}
+
+static void lgc_sweep_env(lenv *e) {
+    for (int i = 0; i < e->count; ++i)
+        lsym_unbind(e->syms[i]);
+
+    lcells_resize(e->syms, e->capacity, 0);
+    lcells_resize(e->vals, e->capacity, 0);
+    lgc.bytes_reclaimed += lenv_pool.size + 2 * e->capacity * sizeof(void *);
+
+    if (e->index) {
+        lgc.bytes_reclaimed += (e->index_mask + 1) * sizeof(int);
+        free(e->index);
+    }
+
+    lpool_free(&lenv_pool, e);
+}
+
+//
+// Collect.
+//
+
+void lgc_collect(lenv *e, lval **roots, const int root_count) {
+    const clock_t start = clock();
+
+    // Mark everything that is reachable (or free, so it isn't swept).
+    lpool_clear_marks(&lval_pool);
+    lpool_clear_marks(&lenv_pool);
+
+    lgc_mark_env(e);
+    for (int i = 0; i < root_count; ++i)
+        lgc_mark(roots[i]);
+
+    // (Memoized results are kept until they're evicted.)
+    lmemo_each(lgc_mark);
+
+    // (Frames are reused, so even the ones not in use are kept.)
+    for (int i = 0; i < lenv_frame_count; ++i)
+        lgc_mark_env(lenv_frames[i]);
+
+    lpool_mark_free(&lval_pool);
+    lpool_mark_free(&lenv_pool);
+
+    // Gather what is left, before anything is freed.
+    lgc_garbage vals = { NULL, 0, 0 };
+    lgc_garbage envs = { NULL, 0, 0 };
+    lpool_each_unmarked(&lval_pool, lgc_gather, &vals);
+    lpool_each_unmarked(&lenv_pool, lgc_gather, &envs);
+
+    // Drop the references from garbage to live values, then delete the garbage itself.
+    for (int i = 0; i < vals.count; ++i)
+        lgc_release_refs(vals.objects[i]);
+
+    for (int i = 0; i < envs.count; ++i) {
+        lenv *env = envs.objects[i];
+        for (int j = 0; j < env->count; ++j)
+            lgc_release(env->vals[j]);
+
+        if (env->parent_ref && lpool_is_marked(env->parent_ref)) lenv_free(env->parent_ref);
+    }
+
+    for (int i = 0; i < vals.count; ++i) lgc_sweep_lval(vals.objects[i]);
+    for (int i = 0; i < envs.count; ++i) lgc_sweep_env(envs.objects[i]);
+
+    lgc.objects_reclaimed += vals.count + envs.count;
+    free(vals.objects);
+    free(envs.objects);
+
+    // Update the statistics.
+    const unsigned long pause_us =
+        (unsigned long)((double)(clock() - start) * 1000000.0 / CLOCKS_PER_SEC);
+
+    lgc.collections++;
+    lgc.pause_us += pause_us;
+    if (pause_us > lgc.max_pause_us) lgc.max_pause_us = pause_us;
+
+    last_allocs = lgc_allocs();
+}
+
+void lgc_maybe_collect(lenv *e, lval **roots, const int root_count) {
+    if (lgc.threshold && lgc_allocs() - last_allocs >= lgc.threshold)
+        lgc_collect(e, roots, root_count);
+}
@@ -0,0 +1,35 @@
+#ifndef __CLISP_GC_H__
+#define __CLISP_GC_H__
+
+#include "lval.h"
+
+// An (opt-in) tracing mark-and-sweep collector, which backs up reference counting.
+//
+// Since values are shared by reference, anything that is no longer reachable from the
+// global environment (nor from the values being evaluated) but that wasn't deleted,
+// e.g. cyclic references, is garbage. Collection is triggered by allocation pressure,
+// but only at safe points, where every value in use is known to be reachable from roots:
+// in between top-level expressions (see `lval_top_level`). The native stack isn't scanned,
+// so anywhere else, values still in use (e.g. the arguments of a built-in, or what it has
+// computed so far) may be unreachable, and would be collected.
+
+typedef struct lgc_stats {
+    unsigned long threshold; // lval/lenv allocations between collections (0 if disabled)
+
+    unsigned long collections;
+    unsigned long pause_us;     // total time spent collecting, in microseconds
+    unsigned long max_pause_us;
+    unsigned long objects_reclaimed;
+    unsigned long bytes_reclaimed;
+} lgc_stats;
+
+extern lgc_stats lgc;
+
+// Collects every value that isn't reachable from `e` nor from `roots`.
+void lgc_collect(lenv *e, lval **roots, const int root_count);
+
+// Calls `lgc_collect` if collection is enabled, and at least `lgc.threshold`
+// lvals and lenvs have been allocated since the last collection (at a safe point).
+void lgc_maybe_collect(lenv *e, lval **roots, const int root_count);
+
+#endif // __CLISP_GC_H__
@@ -1,61 +1,103 @@
 #include "lval.h"
+#include "fold.h"
+#include "gc.h"
+#include "mem.h"
+#include "memo.h"
+#include "sym.h"
+#include "vm.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdarg.h>
 
+lpool lval_pool = LPOOL(lval);
+lpool lenv_pool = LPOOL(lenv);
+
+int lval_eval_depth = 0;
+bool lval_top_level = true;
+int lval_max_depth = LVAL_MAX_DEPTH;
+bool lval_native_lists = true;
+
+// Number of frames kept by calls in tail position (see `lval_eval_body`), which count
+// towards the depth of evaluation, but take no native stack.
+static int lval_kept_frames = 0;
+
 //
 // Constructors.
 //
 
 lval *lval_num(const long num) {
-    lval *v = malloc(sizeof(lval));
+    if (num >= LVAL_IMM_MIN && num <= LVAL_IMM_MAX)
+        return (lval *)(((uintptr_t)num << 1) | LVAL_IMM_TAG);
+
+    lval *v = lpool_alloc(&lval_pool);
     v->type = LVAL_NUM;
+    v->refs = 1;
     v->num = num;
     return v;
 }
 
+// Copies the first `len` characters of `str` into `v`, inline if they fit.
+static void lval_set_str(lval *v, const char *str, const int len) {
+    v->str = len <= LVAL_SHORT_STR_LEN ? v->chars : malloc(len + 1);
+    v->len = len;
+    memcpy(v->str, str, len);
+    v->str[len] = '\0';
+}
+
 lval *lval_err(const char *fmt, ...) {
-    lval *v = malloc(sizeof(lval));
+    lval *v = lpool_alloc(&lval_pool);
     v->type = LVAL_ERR;
+    v->refs = 1;
+
+    // Format the message on the stack, so that only the bytes used are allocated.
+    char err[MAX_ERR_LEN + 1];
 
     va_list va;
     va_start(va, fmt);
-    v->err = malloc(MAX_ERR_LEN + 1);
-    vsnprintf(v->err, MAX_ERR_LEN, fmt, va);
-
-    // Reallocate the message to the number of bytes actually used.
-    v->err = realloc(v->err, strlen(v->err) + 1);
-
+    vsnprintf(err, MAX_ERR_LEN, fmt, va);
     va_end(va);
+
+    lval_set_str(v, err, (int)strlen(err));
     return v;
 }
 
 lval *lval_sym(const char *sym) {
-    lval *v = malloc(sizeof(lval));
+    lval *v = lpool_alloc(&lval_pool);
     v->type = LVAL_SYM;
-    v->sym = malloc(strlen(sym) + 1);
-    strcpy(v->sym, sym);
+    v->refs = 1;
+    v->sym = lsym_intern(sym);
+    v->slot = -1;
     return v;
 }
 
 lval *lval_str(const char *str) {
-    lval *v = malloc(sizeof(lval));
+    lval *v = lpool_alloc(&lval_pool);
     v->type = LVAL_STR;
-    v->str = malloc(strlen(str) + 1);
-    strcpy(v->str, str);
+    v->refs = 1;
+    lval_set_str(v, str, (int)strlen(str));
     return v;
 }
 
-lval *lval_fun(lbuiltin fun) {
-    lval *v = malloc(sizeof(lval));
+const lbuiltin lop_funs[LOP_COUNT] = {
+#define LBUILTIN_FUN(name, op, fun, pure) [op] = fun,
+    LBUILTINS(LBUILTIN_FUN)
+#undef LBUILTIN_FUN
+};
+
+lval *lval_fun(const LOP op) {
+    lval *v = lpool_alloc(&lval_pool);
     v->type = LVAL_FUN;
-    v->builtin = fun;
+    v->refs = 1;
+    v->builtin = lop_funs[op];
+    v->op = op;
     return v;
 }
 
 lval *lval_lambda(lval *formals, lval *body) {
-    lval *v = malloc(sizeof(lval));
+    lval *v = lpool_alloc(&lval_pool);
     v->type = LVAL_FUN;
+    v->refs = 1;
     v->builtin = NULL;
     v->env = lenv_new();
     v->formals = formals;
@@ -64,41 +106,219 @@ lval *lval_lambda(lval *formals, lval *body) {
 }
 
 lval *lval_sexpr(void) {
-    lval *v = malloc(sizeof(lval));
+    lval *v = lpool_alloc(&lval_pool);
     v->type = LVAL_SEXPR;
+    v->refs = 1;
     v->cell_count = 0;
+    v->memo = false;
     v->cell = NULL;
+    v->store = NULL;
+    v->code = NULL;
     return v;
 }
 
 lval *lval_qexpr(void) {
-    lval *v = malloc(sizeof(lval));
+    lval *v = lpool_alloc(&lval_pool);
     v->type = LVAL_QEXPR;
+    v->refs = 1;
     v->cell_count = 0;
+    v->memo = false;
     v->cell = NULL;
+    v->store = NULL;
+    v->code = NULL;
     return v;
 }
 
 lenv *lenv_new(void) {
-    lenv *e = malloc(sizeof(lenv));
+    lenv *e = lpool_alloc(&lenv_pool);
+    e->refs = 1;
     e->parent_ref = NULL;
+    e->caller_ref = NULL;
+    e->global_ref = NULL;
     e->count = 0;
+    e->capacity = 0;
     e->syms = NULL;
     e->vals = NULL;
+    e->index = NULL;
+    e->index_mask = 0;
     return e;
 }
 
+//
+// Cell storage.
+//
+
+// Storage is allocated with a power-of-two number of (pointer-sized) slots, its header
+// included, which matches the size classes of `lcells_resize`, and grows geometrically.
+#define LCELLS_MIN_SLOTS 4
+
+static int lcells_slots(const int capacity) {
+    int slots = LCELLS_MIN_SLOTS;
+    while (slots < LCELLS_HEADER + capacity) slots *= 2;
+    return slots;
+}
+
+// Allocates storage with room for (at least) `capacity` cells.
+static lcells *lcells_new(const int capacity) {
+    const int slots = lcells_slots(capacity);
+
+    lcells *store = lcells_resize(NULL, 0, slots);
+    store->refs = 1;
+    store->start = 0;
+    store->count = 0;
+    store->capacity = slots - LCELLS_HEADER;
+    return store;
+}
+
+static void lcells_delete(lcells *store) {
+    lcells_resize(store, LCELLS_HEADER + store->capacity, 0);
+}
+
+// Moves the cells of `store` (which must not be shared) to its start, then reallocates
+// it with room for (at least) `capacity` cells.
+static lcells *lcells_realloc(lcells *store, const int capacity) {
+    const int count = store->count - store->start;
+
+    if (store->start > 0) {
+        memmove(store->cell, store->cell + store->start, count * sizeof(lval *));
+        store->start = 0;
+        store->count = count;
+    }
+
+    const int slots = lcells_slots(capacity);
+    if (slots == LCELLS_HEADER + store->capacity) return store;
+
+    store = lcells_resize(store, LCELLS_HEADER + store->capacity, slots);
+    store->capacity = slots - LCELLS_HEADER;
+    return store;
+}
+
+// Drops a reference to `store`, deleting it (and its cells) if it was the last one.
+static void lcells_release(lcells *store) {
+    if (--(store->refs) > 0) return;
+
+    for (int i = store->start; i < store->count; ++i)
+        lval_free(store->cell[i]);
+
+    lcells_delete(store);
+}
+
+// Ensures that `v` is the sole owner of its cells, and that they span its whole storage,
+// so that they can be modified: if they're shared, `v` gets its own copy of them, while,
+// if only a slice of the storage is used, the cells outside of it are deleted.
+static void lval_unshare_cells(lval *v) {
+    lcells *store = v->store;
+    if (!store) return;
+
+    const int first = (int)(v->cell - store->cell);
+    const int last = first + v->cell_count;
+
+    if (store->refs == 1 && first == store->start && last == store->count) return;
+
+    if (v->cell_count == 0) {
+        lcells_release(store);
+        v->store = NULL;
+        v->cell = NULL;
+        return;
+    }
+
+    if (store->refs > 1) {
+        lcells *copy = lcells_new(v->cell_count);
+        for (int i = 0; i < v->cell_count; ++i)
+            copy->cell[i] = lval_copy(v->cell[i]);
+        copy->count = v->cell_count;
+
+        store->refs--;
+        v->store = copy;
+        v->cell = copy->cell;
+        return;
+    }
+
+    // Delete the cells before and after the slice.
+    for (int i = store->start; i < first; ++i)
+        lval_free(store->cell[i]);
+    for (int i = last; i < store->count; ++i)
+        lval_free(store->cell[i]);
+
+    store->start = first;
+    store->count = last;
+}
+
+lval *lval_reserve(lval *v, const int count) {
+    lval_unshare_cells(v);
+
+    if (!v->store) {
+        if (count > 0) {
+            v->store = lcells_new(count);
+            v->cell = v->store->cell;
+        }
+    } else if (v->store->count + count > v->store->capacity) {
+        const int needed = v->cell_count + count;
+        const int capacity = v->store->capacity;
+
+        if (2 * needed <= capacity) {
+            // Mostly popped from the front, so simply move the cells back to the start.
+            v->store = lcells_realloc(v->store, capacity);
+        } else {
+            // Grow (at least) geometrically, so that adding cells takes amortized O(1).
+            v->store = lcells_realloc(v->store, needed > 2 * capacity ? needed : 2 * capacity);
+        }
+        v->cell = v->store->cell;
+    }
+
+    return v;
+}
+
 //
 // Destructor.
 //
 
+// Counts the references to `e` held by closures that are only referenced by bindings of
+// `e` itself (i.e. cycles through the environment, such as a function that defines a local
+// closure).
+static int lenv_self_refs(const lenv *e) {
+    int refs = 0;
+    for (int i = 0; i < e->count; ++i) {
+        const lval *v = e->vals[i];
+        if (lval_type_of(v) == LVAL_FUN && !v->builtin && v->refs == 1
+            && v->env->refs == 1 && v->env->parent_ref == e) refs++;
+    }
+    return refs;
+}
+
+// Deletes `e` if it's only referenced by its own closures (see `lenv_self_refs`), which
+// reference counting alone would never do.
+static void lenv_free_cycle(lenv *e) {
+    if (e->refs != lenv_self_refs(e)) return;
+
+    // Deleting its bindings releases the closures' references, but not this one.
+    e->refs++;
+    for (int i = 0; i < e->count; ++i) {
+        lsym_unbind(e->syms[i]);
+        lval_free(e->vals[i]);
+    }
+    e->count = 0;
+
+    lenv_free(e);
+}
+
 void lval_free(lval *v) {
+    if (lval_is_imm(v)) return;
+
+    // Only delete the value once its last reference is gone. A closure down to its last
+    // one may be what's left of a cycle through the environment it captured, though.
+    if (--(v->refs) > 0) {
+        if (v->refs == 1 && v->type == LVAL_FUN && !v->builtin && v->env->parent_ref)
+            lenv_free_cycle(v->env->parent_ref);
+        return;
+    }
+
     switch (v->type) {
         case LVAL_NUM: break;
 
-        case LVAL_ERR: free(v->err); break;
-        case LVAL_SYM: free(v->sym); break;
-        case LVAL_STR: free(v->str); break;
+        case LVAL_ERR: if (lval_str_is_long(v)) free(v->err); break;
+        case LVAL_SYM: break; // interned
+        case LVAL_STR: if (lval_str_is_long(v)) free(v->str); break;
 
         case LVAL_FUN:
             if (!v->builtin) {
@@ -110,29 +330,32 @@ void lval_free(lval *v) {
 
         case LVAL_SEXPR:
         case LVAL_QEXPR:
-            while (v->cell_count)
-                lval_free(v->cell[--(v->cell_count)]);
-
-            free(v->cell);
+            // Likewise, only delete the cells once they're no longer shared.
+            if (v->store) lcells_release(v->store);
+            free(v->code);
             break;
 
         default: assert(false);
     }
 
-    free(v);
+    lpool_free(&lval_pool, v);
 }
 
 void lenv_free(lenv *e) {
+    if (--(e->refs) > 0) return;
+
     for (int i = 0; i < e->count; ++i) {
-        free(e->syms[i]);
+        lsym_unbind(e->syms[i]);
         lval_free(e->vals[i]);
     }
 
     // Free allocated memory for lists.
-    free(e->syms);
-    free(e->vals);
+    lcells_resize(e->syms, e->capacity, 0);
+    lcells_resize(e->vals, e->capacity, 0);
+    free(e->index);
 
-    free(e);
+    if (e->parent_ref) lenv_free(e->parent_ref);
+    lpool_free(&lenv_pool, e);
 }
 
 //
@@ -153,25 +376,43 @@ char *lval_type_name(LVAL_TYPE t) {
 }
 
 lval *lval_add(lval *v, lval *x) {
-    v->cell_count++;
-    v->cell = realloc(v->cell, v->cell_count * sizeof(lval *));
-    v->cell[v->cell_count - 1] = x;
+    lval_reserve(v, 1);
+    v->cell[v->cell_count++] = x;
+    v->store->count++;
     return v;
 }
 
 lval *lval_pop(lval *v, const int i) {
+    lval_unshare_cells(v);
+    lcells *store = v->store;
     lval *x = v->cell[i];
 
-    // Shift memory after the `i`-th cell item (i.e. `x`),
-    // update the cell count, and reallocate the memory used.
-    memmove(
-        /*dst*/&v->cell[i],
-        /*src*/&v->cell[i + 1],
-        /*count*/(v->cell_count - (i + 1)) * sizeof(lval *)
-    );
+    if (i == 0) {
+        // Popping from the front simply skips over the cell.
+        store->start++;
+        v->cell++;
+    } else {
+        // Shift memory after the `i`-th cell item (i.e. `x`).
+        memmove(
+            /*dst*/&v->cell[i],
+            /*src*/&v->cell[i + 1],
+            /*count*/(v->cell_count - (i + 1)) * sizeof(lval *)
+        );
+        store->count--;
+    }
 
     v->cell_count--;
-    v->cell = realloc(v->cell, v->cell_count * sizeof(lval *));
+
+    if (v->cell_count == 0) {
+        // Delete the (now empty) storage.
+        lcells_delete(store);
+        v->store = NULL;
+        v->cell = NULL;
+    } else if (4 * v->cell_count < store->capacity) {
+        // Lazily shrink the storage, once it's mostly unused.
+        v->store = lcells_realloc(store, 2 * v->cell_count);
+        v->cell = v->store->cell;
+    }
 
     return x;
 }
@@ -183,20 +424,40 @@ lval *lval_take(lval *v, const int i) {
 }
 
 lval *lval_join(lval *x, lval *y) {
-#if false
-    for (int i = 0; i < y->cell_count; ++i)
-        x = lval_add(x, y->cell[i]);
-
-    lval_free(y->cell);
-    lval_free(y);
-#else
-    // For each cell in `y` add it to `x`.
-    while (y->cell_count) x = lval_add(x, lval_pop(y, 0));
+    if (y->cell_count == 0) {
+        // Nothing to add.
+    } else if (x->cell_count == 0) {
+        // Simply take over the cells of `y` (shared or not).
+        lval_unshare_cells(x);
+        x->cell_count = y->cell_count;
+        x->cell = y->cell;
+        x->store = y->store;
+
+        y->cell_count = 0;
+        y->cell = NULL;
+        y->store = NULL;
+    } else if (y->store && y->store->refs > 1) {
+        // The cells of `y` are shared, so `x` gets its own copy of them.
+        x = lval_reserve(x, y->cell_count);
+        for (int i = 0; i < y->cell_count; ++i)
+            x->cell[x->cell_count + i] = lval_copy(y->cell[i]);
+
+        x->cell_count += y->cell_count;
+        x->store->count += y->cell_count;
+    } else if (y->store) {
+        // Move the cells of `y` to the end of `x` (which only grows once),
+        // leaving `y` with an empty storage.
+        lval_unshare_cells(y);
+        x = lval_reserve(x, y->cell_count);
+        memcpy(&x->cell[x->cell_count], y->cell, y->cell_count * sizeof(lval *));
+
+        x->cell_count += y->cell_count;
+        x->store->count += y->cell_count;
+        y->store->count = y->store->start;
+    }
 
-    // Delete the empty `y` and return `x`.
+    // Delete `y` and return `x`.
     lval_free(y);
-#endif
-
     return x;
 }
 
@@ -206,51 +467,87 @@ lval *lval_join(lval *x, lval *y) {
 // `{x & xs}` will take in a single argument `x`, followed by zero or more other
 // arguments, joined together into a list called `xs`.
 
-lval *lval_call(lenv *e, lval *f, lval *a) {
+bool lval_is_rest(const lval *v) {
+    static const char *rest = NULL;
+    if (!rest) rest = lsym_intern("&");
+    return v->sym == rest;
+}
+
+static lval *lval_eval_body(lenv *frame, lval *body);
+
+// Calls `f` on `a` as `lval_call` does, unless `tail` isn't NULL and `f` is a lambda whose
+// arguments are all bound without errors. Then, its body isn't evaluated, but its frame is
+// left on top of the stack for the caller to do so, returned in `*tail` (along with NULL).
+static lval *lval_call_frame(lenv *e, lval *f, lval *a, lenv **tail) {
     // If `f` is a built-in, simply call it.
     if (f->builtin) return f->builtin(e, a);
 
-    // Otherwise, assign each argument in order. Note that,
-    // if given < total, the function is partially applied.
+    // If `f` has a native implementation, it may make the call by itself.
+    const lnative native = lcode_native(f->body);
+    if (native) {
+        lval *result = native(a->cell, a->cell_count);
+        if (result) {
+            lval_free(a);
+            return result;
+        }
+    }
+
+    // If calls to `f` are memoized, this one may already have been evaluated. Otherwise,
+    // keep (a copy of) its arguments, to memoize its result. (Unless the built-ins it calls
+    // may be shadowed or rebound, in which case its result may differ.)
+    lval *memo_args = NULL;
+    unsigned memo_hash = 0;
+    if (f->body->memo && lsym_builtins_resolved()) {
+        lval *result = lmemo_get(f, a, &memo_hash);
+        if (result) {
+            lval_free(a);
+            return result;
+        }
+        memo_args = lval_copy(a);
+    }
+
+    // Otherwise, assign each argument in order, in a new frame (as `f` is never modified),
+    // which starts with the arguments already bound by partial applications of `f`.
+    // Note that, if given < total, the function is partially applied.
     const int given = a->cell_count;
     const int total = f->formals->cell_count;
 
+    lenv *frame = lenv_push_frame(f->env);
+    lval *err = NULL;
+    int bound = 0; // number of formals bound
+
     while (a->cell_count) {
-        if (f->formals->cell_count == 0) {
-            lval_free(a);
-            return lval_err(
+        if (bound == total) {
+            err = lval_err(
                 "function passed too many arguments. "
                 "Got %i, expected %i.", given, total
             );
+            break;
         }
 
-        lval *sym = lval_pop(f->formals, 0);
+        lval *sym = f->formals->cell[bound++];
 #if VARIABLE_ARGUMENTS
         // Special case to handle '&'.
-        if (!strcmp(sym->sym, "&")) {
+        if (lval_is_rest(sym)) {
             // Ensure '&' is followed by another symbol.
-            if (f->formals->cell_count != 1) {
-                lval_free(a);
-                return lval_err(
+            if (total - bound != 1) {
+                err = lval_err(
                     "function format invalid. "
                     "Symbol '&' not followed by single symbol."
                 );
+                break;
             }
 
             // Next formal should be bound to the remaining arguments.
-            lval *nsym = lval_pop(f->formals, 0);
-            lenv_put(f->env, nsym, lval_builtin_list(e, a));
-
-            lval_free(sym);
-            lval_free(nsym);
+            lval *nsym = f->formals->cell[bound++];
+            lenv_put(frame, nsym, lval_builtin_list(e, a));
             break;
         }
 #endif
         lval *val = lval_pop(a, 0);
 
-        lenv_put(f->env, sym, val);
+        lenv_put(frame, sym, val);
 
-        lval_free(sym);
         lval_free(val);
     }
 
@@ -259,156 +556,332 @@ lval *lval_call(lenv *e, lval *f, lval *a) {
 
 #if VARIABLE_ARGUMENTS
     // If '&' remains in the formal list, bind to empty list.
-    if (f->formals->cell_count > 0
-        && !strcmp(f->formals->cell[0]->sym, "&")) {
+    if (!err && bound < total && lval_is_rest(f->formals->cell[bound])) {
         // Ensure that '&' is not passed invalidly.
-        if (f->formals->cell_count != 2)
-            return lval_err(
+        if (total - bound != 2) {
+            err = lval_err(
                 "function format invalid. "
                 "Symbol '&' not followed by single symbol."
             );
+        } else {
+            // Skip the '&' symbol, and bind the next one to an empty list.
+            lval *val = lval_qexpr();
+            lenv_put(frame, f->formals->cell[bound + 1], val);
+            lval_free(val);
+            bound += 2;
+        }
+    }
+#endif
 
-        // Pop and delete the '&' symbol.
-        lval_free(lval_pop(f->formals, 0));
-
-        // Pop next symbol and create empty list.
-        lval *sym = lval_pop(f->formals, 0);
-        lval *val = lval_qexpr();
+    lval *result = NULL;
+    if (err) {
+        result = err;
+    } else if (bound == total) {
+        // If all formals have been bound, evaluate the body.
+        // Set the caller reference to the evaluation environment (and its global one).
+        frame->caller_ref = e;
+        frame->global_ref = e->global_ref ? e->global_ref : e;
+
+        if (tail && !memo_args) {
+            *tail = frame;
+            return NULL;
+        }
 
-        lenv_put(f->env, sym, val);
+        result = lvm_enabled
+            ? lvm_run(frame, f->body)
+            : lval_eval_body(frame, f->body);
+    } else {
+        // Otherwise, return the partially evaluated function,
+        // i.e. a new one that is missing the formals which were bound.
+        lval *formals = lval_copy(f->formals);
+        formals->cell += bound;
+        formals->cell_count -= bound;
+
+        result = lval_lambda(formals, lval_copy(f->body));
+        result->body->memo = f->body->memo;
+        lenv_free(result->env);
+        result->env = lenv_copy(frame);
+    }
 
-        lval_free(sym);
-        lval_free(val);
+    // Only the results of (complete) calls are memoized.
+    if (memo_args) {
+        if (!err && bound == total) lmemo_put(f, memo_args, memo_hash, result);
+        else lval_free(memo_args);
     }
-#endif
 
-    // If all formals have been bound, evaluate.
-    if (f->formals->cell_count == 0) {
-        // Set the parent reference to the evaluation environment.
-        f->env->parent_ref = e;
+    lenv_pop_frame();
+    return result;
+}
 
-        // Evaluate the body and return.
-        return lval_builtin_eval(
-            f->env,
-            lval_add(lval_sexpr(), lval_copy(f->body))
-        );
+lval *lval_call(lenv *e, lval *f, lval *a) {
+    return lval_call_frame(e, f, a, NULL);
+}
+
+// Evaluates `body` on `frame` (on top of the stack), making the calls in its tail position
+// in turn rather than recursively (see `lval_eval_tail`). Each of them replaces the frame
+// it's made from if nothing can be looked up in it anymore (see `lenv_shadows`), as with
+// the virtual machine. Otherwise, that frame is kept until the end (as a nested call).
+static lval *lval_eval_body(lenv *frame, lval *body) {
+    lval *fun = NULL; // (the function whose body is being evaluated, unless it's `body`)
+    int kept = 0;     // (frames pushed on top of `frame`)
+
+    lval *call = NULL;
+    lval *x;
+    while (!(x = lval_eval_tail(frame, body, &call))) {
+        lval *f = lval_pop(call, 0);
+        lenv *next = NULL;
+        x = lval_call_frame(frame, f, call, &next);
+        if (!next) {
+            lval_free(f);
+            break;
+        }
+
+        if (lenv_shadows(next, frame)) {
+            next->caller_ref = frame->caller_ref;
+            lenv_drop_frame();
+        } else {
+            kept++;
+            lval_kept_frames++;
+            if ((x = lval_check_depth())) {
+                lval_free(f);
+                break;
+            }
+        }
+
+        if (fun) lval_free(fun);
+        fun = f;
+        frame = next;
+        body = f->body;
     }
 
-    // Otherwise, return the partially evaluated function.
-    return lval_copy(f);
+    for (int i = 0; i < kept; ++i) lenv_pop_frame();
+    lval_kept_frames -= kept;
+    if (fun) lval_free(fun);
+    return x;
 }
 
 lval *lval_copy(lval *v) {
-    lval *x = malloc(sizeof(lval));
-    x->type = v->type;
+    if (lval_is_imm(v)) return v;
 
-    switch (v->type) {
-        case LVAL_NUM: x->num = v->num; break;
+    // Values that are never modified are simply shared.
+    if (v->type != LVAL_SEXPR && v->type != LVAL_QEXPR) {
+        v->refs++;
+        return v;
+    }
 
-        case LVAL_ERR:
-            x->err = malloc(strlen(v->err) + 1);
-            strcpy(x->err, v->err);
-            break;
+    // Share the cells of `v`, until either of them is modified.
+    lval *x = lpool_alloc(&lval_pool);
+    x->refs = 1;
+    x->type = v->type;
+    x->cell_count = v->cell_count;
+    x->memo = false;
+    x->cell = v->cell;
+    x->store = v->store;
+    if (x->store) x->store->refs++;
+    x->code = NULL; // (only needed by the function which owns `v`)
 
-        case LVAL_SYM:
-            x->sym = malloc(strlen(v->sym) + 1);
-            strcpy(x->sym, v->sym);
-            break;
+    return x;
+}
 
-        case LVAL_STR:
-            x->str = malloc(strlen(v->str) + 1);
-            strcpy(x->str, v->str);
-            break;
+// Environments with more bindings than this are also indexed by a hash table.
+#define LENV_INDEX_MIN 8
 
-        case LVAL_FUN:
-            if (v->builtin) {
-                x->builtin = v->builtin;
-            } else {
-                x->builtin = NULL;
-                x->env = lenv_copy(v->env);
-                x->formals = lval_copy(v->formals);
-                x->body = lval_copy(v->body);
-            }
-            break;
+// Returns the position of `sym` in `e->syms` (ignoring any parent environment), or -1.
+static int lenv_find(const lenv *e, const char *sym) {
+    if (e->index) {
+        for (unsigned i = lsym_hash(sym) & e->index_mask; e->index[i]; i = (i + 1) & e->index_mask)
+            if (e->syms[e->index[i] - 1] == sym) return e->index[i] - 1;
+        return -1;
+    }
 
-        case LVAL_SEXPR:
-        case LVAL_QEXPR:
-            x->cell_count = v->cell_count;
-            x->cell = malloc(x->cell_count * sizeof(lval *));
-            for (int i = 0; i < x->cell_count; ++i)
-                x->cell[i] = lval_copy(v->cell[i]);
+    for (int i = 0; i < e->count; ++i)
+        if (e->syms[i] == sym) return i;
+    return -1;
+}
 
-            break;
+// Adds the binding at position `i` to the index of `e`.
+static void lenv_index_insert(lenv *e, const int i) {
+    unsigned j = lsym_hash(e->syms[i]) & e->index_mask;
+    while (e->index[j]) j = (j + 1) & e->index_mask;
+    e->index[j] = i + 1;
+}
 
-        default: assert(false);
-    }
+// (Re)builds the index of `e`, keeping its load factor under 1/2 (up to its capacity).
+static void lenv_reindex(lenv *e) {
+    unsigned size = 4 * LENV_INDEX_MIN;
+    while (size < 2 * (unsigned)e->capacity) size *= 2;
 
-    return x;
+    free(e->index);
+    e->index = calloc(size, sizeof(int));
+    e->index_mask = size - 1;
+
+    for (int i = 0; i < e->count; ++i)
+        lenv_index_insert(e, i);
 }
 
 lenv *lenv_copy(lenv *e) {
-    lenv *n = malloc(sizeof(lenv));
+    lenv *n = lpool_alloc(&lenv_pool);
+    n->refs = 1;
     n->parent_ref = e->parent_ref;
+    n->caller_ref = NULL;
+    n->global_ref = e->global_ref;
+    if (n->parent_ref) n->parent_ref->refs++;
     n->count = e->count;
+    n->capacity = e->count;
 
-    n->syms = malloc(n->count * sizeof(char *));
-    n->vals = malloc(n->count * sizeof(lval *));
+    n->syms = lcells_resize(NULL, 0, n->capacity);
+    n->vals = lcells_resize(NULL, 0, n->capacity);
 
     for (int i = 0; i < e->count; ++i) {
-        n->syms[i] = malloc(strlen(e->syms[i]) + 1);
-        strcpy(n->syms[i], e->syms[i]);
-
+        n->syms[i] = e->syms[i];
         n->vals[i] = lval_copy(e->vals[i]);
+        lsym_bind(n->syms[i]);
     }
 
+    n->index = NULL;
+    n->index_mask = 0;
+    if (n->capacity > LENV_INDEX_MIN) lenv_reindex(n);
+
     return n;
 }
 
 lval *lenv_get(lenv *e, lval *k) {
-    // Iterate over all items in the environment,
-    // checking if the stored string matches the symbol string.
-    for (int i = 0; i < e->count; ++i) {
-        if (!strcmp(e->syms[i], k->sym)) {
-            // If it does, return a copy of the value.
-            return lval_copy(e->vals[i]);
-        }
+    // Since the innermost binding is the one that matters, if the symbol is still in
+    // its slot, there's no need to look it up (e.g. for the arguments of a function).
+    if (k->slot >= 0 && k->slot < e->count && e->syms[k->slot] == k->sym)
+        return lval_copy(e->vals[k->slot]);
+
+    // If the symbol is only bound in a single environment, and that's the global one,
+    // then it can't be shadowed, so skip every environment in between.
+    if (lsym_bindings(k->sym) == 1) {
+        lenv *global = e->global_ref ? e->global_ref : e;
+        const int i = lenv_find(global, k->sym);
+        if (i >= 0) return lval_copy(global->vals[i]);
     }
 
-    // If no symbol is found, check for it in the parent environment.
-    if (e->parent_ref) return lenv_get(e->parent_ref, k);
+    // Note that the callers eventually lead to the global environment.
+    for (lenv *caller = e; caller; caller = caller->caller_ref) {
+        for (lenv *env = caller; env; env = env->parent_ref) {
+            // If no symbol is found, check for it in the parent environment.
+            const int i = lenv_find(env, k->sym);
+            if (i < 0) continue;
+
+            // Otherwise, return a copy of its value (remembering its slot, if it's local).
+            if (env == e) k->slot = i;
+            return lval_copy(env->vals[i]);
+        }
+    }
 
     return lval_err("unbound symbol `%s`", k->sym);
 }
 
-void lenv_put(lenv *e, lval *k, lval *v) {
-    // Iterate over all items in the environment
-    // to see if the variable already exists.
-    for (int i = 0; i < e->count; ++i) {
-        if (!strcmp(e->syms[i], k->sym)) {
-            // If it is found, delete the item at that position
-            // and replace it with a copy of the given variable.
-            lval_free(e->vals[i]);
-            e->vals[i] = lval_copy(v);
-            return;
-        }
+// Puts `v`, mapped by `sym`, in `e` itself (see `lenv_put`).
+static void lenv_bind(lenv *e, const char *sym, lval *v) {
+    // If the variable already exists, delete its value
+    // and replace it with a copy of the given one.
+    // (Then, if it's a global bound to a built-in function, it may no longer be.)
+    const int i = lenv_find(e, sym);
+    if (i >= 0) {
+        lval_free(e->vals[i]);
+        e->vals[i] = lval_copy(v);
+        if (!e->global_ref) lsym_rebind(sym);
+        return;
+    }
+
+    // If no existing entry is found, make space for a new one (doubling the capacity).
+    if (e->count == e->capacity) {
+        const int capacity = e->capacity ? 2 * e->capacity : 4;
+        e->syms = lcells_resize(e->syms, e->capacity, capacity);
+        e->vals = lcells_resize(e->vals, e->capacity, capacity);
+        e->capacity = capacity;
+
+        if (e->capacity > LENV_INDEX_MIN) lenv_reindex(e);
     }
 
-    // If no existing entry is found, allocate space for a new one.
+    e->syms[e->count] = sym;
+    e->vals[e->count] = lval_copy(v);
     e->count++;
+    lsym_bind(sym);
 
-    e->syms = realloc(e->syms, e->count * sizeof(char *));
-    e->syms[e->count - 1] = malloc(strlen(k->sym) + 1);
-    strcpy(e->syms[e->count - 1], k->sym);
+    if (e->index) lenv_index_insert(e, e->count - 1);
+}
 
-    e->vals = realloc(e->vals, e->count * sizeof(lval *));
-    e->vals[e->count - 1] = lval_copy(v);
+void lenv_put(lenv *e, lval *k, lval *v) {
+    lenv_bind(e, k->sym, v);
 }
 
-void lenv_def(lenv *e, lval *k, lval *v) {
-    while (e->parent_ref)
-        e = e->parent_ref;
+// Frames in which functions are called, which are pushed and popped as a stack.
+// Since they're reused, only the first `lenv_frame_top` of them are in use.
+lenv **lenv_frames = NULL;
+int lenv_frame_count = 0;
+int lenv_frame_top = 0;
+
+lenv *lenv_push_frame(const lenv *bindings) {
+    if (lenv_frame_top == lenv_frame_count) {
+        lenv_frame_count = lenv_frame_count ? 2 * lenv_frame_count : 64;
+        lenv_frames = realloc(lenv_frames, lenv_frame_count * sizeof(lenv *));
+        for (int i = lenv_frame_top; i < lenv_frame_count; ++i)
+            lenv_frames[i] = lenv_new();
+    }
 
-    lenv_put(e, k, v);
+    lenv *frame = lenv_frames[lenv_frame_top++];
+    frame->parent_ref = bindings->parent_ref;
+    frame->caller_ref = NULL;
+    frame->global_ref = NULL;
+    if (frame->parent_ref) frame->parent_ref->refs++;
+
+    for (int i = 0; i < bindings->count; ++i)
+        lenv_bind(frame, bindings->syms[i], bindings->vals[i]);
+
+    return frame;
+}
+
+void lenv_pop_frame(void) {
+    lenv *frame = lenv_frames[--lenv_frame_top];
+    frame->caller_ref = NULL;
+
+    // If a function has captured it, leave the frame to it and replace it in the stack
+    // (unless those functions are only bound in the frame itself).
+    if (frame->refs - 1 > lenv_self_refs(frame)) {
+        frame->refs--;
+        lenv_frames[lenv_frame_top] = lenv_new();
+        return;
+    }
+
+    // Otherwise, delete its bindings, but keep its memory around for the next call.
+    for (int i = 0; i < frame->count; ++i) {
+        lsym_unbind(frame->syms[i]);
+        lval_free(frame->vals[i]);
+    }
+    frame->count = 0;
+
+    if (frame->parent_ref) {
+        lenv_free(frame->parent_ref);
+        frame->parent_ref = NULL;
+    }
+
+    if (frame->index) memset(frame->index, 0, (frame->index_mask + 1) * sizeof(int));
+}
+
+void lenv_drop_frame(void) {
+    // Swap it with the top frame, so that it's the one popped.
+    lenv *top = lenv_frames[lenv_frame_top - 1];
+    lenv_frames[lenv_frame_top - 1] = lenv_frames[lenv_frame_top - 2];
+    lenv_frames[lenv_frame_top - 2] = top;
+
+    lenv_pop_frame();
+}
+
+bool lenv_shadows(const lenv *e, const lenv *x) {
+    if (e->parent_ref != x->parent_ref) return false;
+
+    for (int i = 0; i < x->count; ++i)
+        if (lenv_find(e, x->syms[i]) < 0) return false;
+    return true;
+}
+
+void lenv_def(lenv *e, lval *k, lval *v) {
+    lenv_put(e->global_ref ? e->global_ref : e, k, v);
 }
 
 //
@@ -424,9 +897,9 @@ void lenv_def(lenv *e, lval *k, lval *v) {
 
 #define LASSERT_ARG_TYPE(fun, args, index, expected)                                       \
     LASSERT(                                                                               \
-        args, (args)->cell[index]->type == expected,                                       \
+        args, lval_type_of((args)->cell[index]) == expected,                               \
         "function '%s' passed incorrect type for argument %i. Got `%s`, expected `%s`.", \
-        fun, index, lval_type_name((args)->cell[index]->type), lval_type_name(expected))
+        fun, index, lval_type_name(lval_type_of((args)->cell[index])), lval_type_name(expected))
 
 #define LASSERT_ARG_COUNT(fun, args, count)                                             \
     LASSERT(                                                                            \
@@ -440,116 +913,117 @@ void lenv_def(lenv *e, lval *k, lval *v) {
         "function '%s' passed `{}` for argument %i.", \
         fun, index)
 
-void lenv_add_builtins(lenv *e) {
-    lenv_add_builtin(e, "\\", lval_builtin_lambda); // user-defined function
-    lenv_add_builtin(e, "def", lval_builtin_def); // user-(globally)-defined variable
-    lenv_add_builtin(e, "=", lval_builtin_put); // user-(locally)-defined variable
-
-    lenv_add_builtin(e, "list", lval_builtin_list);
-    lenv_add_builtin(e, "head", lval_builtin_head);
-    lenv_add_builtin(e, "tail", lval_builtin_tail);
-    lenv_add_builtin(e, "eval", lval_builtin_eval);
-    lenv_add_builtin(e, "join", lval_builtin_join);
-
-    lenv_add_builtin(e, "+", lval_builtin_add);
-    lenv_add_builtin(e, "-", lval_builtin_sub);
-    lenv_add_builtin(e, "*", lval_builtin_mul);
-    lenv_add_builtin(e, "/", lval_builtin_div);
+const char *const lop_names[LOP_COUNT] = {
+#define LBUILTIN_NAME(name, op, fun, pure) [op] = name,
+    LBUILTINS(LBUILTIN_NAME)
+#undef LBUILTIN_NAME
+};
 
-    lenv_add_builtin(e, "<", lval_builtin_lt);
-    lenv_add_builtin(e, ">", lval_builtin_gt);
-    lenv_add_builtin(e, "<=", lval_builtin_le);
-    lenv_add_builtin(e, ">=", lval_builtin_ge);
+const bool lop_pure[LOP_COUNT] = {
+#define LBUILTIN_PURE(name, op, fun, pure) [op] = pure,
+    LBUILTINS(LBUILTIN_PURE)
+#undef LBUILTIN_PURE
+};
 
-    lenv_add_builtin(e, "==", lval_builtin_eq);
-    lenv_add_builtin(e, "!=", lval_builtin_ne);
+#define LBUILTIN_ADD(name, op, fun, pure) lenv_add_builtin(e, name, op);
 
-    lenv_add_builtin(e, "if", lval_builtin_if);
+void lenv_add_builtins(lenv *e) {
+    LBUILTINS_CORE(LBUILTIN_ADD)
+}
 
-    lenv_add_builtin(e, "load", lval_builtin_load);
-    lenv_add_builtin(e, "print", lval_builtin_print);
-    lenv_add_builtin(e, "error", lval_builtin_error);
+void lenv_add_list_builtins(lenv *e) {
+    if (lval_native_lists) {
+        LBUILTINS_LISTS(LBUILTIN_ADD)
+    }
 }
 
-void lenv_add_builtin(lenv *e, const char *name, lbuiltin fun) {
+#undef LBUILTIN_ADD
+
+void lenv_add_builtin(lenv *e, const char *name, const LOP op) {
     lval *k = lval_sym(name);
-    lval *v = lval_fun(fun);
+    lval *v = lval_fun(op);
 
     lenv_put(e, k, v);
+    lsym_set_builtin(k->sym, op);
 
     lval_free(k);
     lval_free(v);
 }
 
-lval *lval_builtin_op(lenv *e, lval *a, const char *op) {
+lval *lval_builtin_op(lenv *e, lval *a, const LOP op) {
     // Ensure all arguments are numbers.
     for (int i = 0; i < a->cell_count; ++i)
-        LASSERT_ARG_TYPE(op, a, /*index*/i, /*expected*/LVAL_NUM);
-
-    // Pop the first element.
-    lval *x = lval_pop(a, 0);
-
-    // If `op` == "-" and there are no arguments, perform unary negation.
-    if (!strcmp(op, "-") && a->cell_count == 0) x->num = -x->num;
-
-    while (a->cell_count > 0) {
-        // Pop the next element.
-        lval *y = lval_pop(a, 0);
-
-        if (!strcmp(op, "+")) x->num += y->num;
-        if (!strcmp(op, "-")) x->num -= y->num;
-        if (!strcmp(op, "*")) x->num *= y->num;
-        if (!strcmp(op, "/")) {
-            if (y->num == 0) {
-                lval_free(x);
-                lval_free(y);
-                x = lval_err("division by zero");
+        LASSERT_ARG_TYPE(lop_names[op], a, /*index*/i, /*expected*/LVAL_NUM);
+
+    // Accumulate on a plain `long`, so that no intermediate result is allocated.
+    long x = lval_num_of(a->cell[0]);
+
+    // If `op` is "-" and there are no other arguments, perform unary negation.
+    if (op == LOP_SUB && a->cell_count == 1) x = -x;
+
+    for (int i = 1; i < a->cell_count; ++i) {
+        const long y = lval_num_of(a->cell[i]);
+
+        switch (op) {
+            case LOP_ADD: x += y; break;
+            case LOP_SUB: x -= y; break;
+            case LOP_MUL: x *= y; break;
+            case LOP_DIV:
+                if (y == 0) {
+                    lval_free(a);
+                    return lval_err("division by zero");
+                }
+                x /= y;
                 break;
-            }
-            x->num /= y->num;
-        }
 
-        lval_free(y);
+            default: assert(false);
+        }
     }
 
     lval_free(a);
-    return x;
+    return lval_num(x);
 }
 
-lval *lval_builtin_add(lenv *e, lval *a) { return lval_builtin_op(e, a, "+"); }
-lval *lval_builtin_sub(lenv *e, lval *a) { return lval_builtin_op(e, a, "-"); }
-lval *lval_builtin_mul(lenv *e, lval *a) { return lval_builtin_op(e, a, "*"); }
-lval *lval_builtin_div(lenv *e, lval *a) { return lval_builtin_op(e, a, "/"); }
+lval *lval_builtin_add(lenv *e, lval *a) { return lval_builtin_op(e, a, LOP_ADD); }
+lval *lval_builtin_sub(lenv *e, lval *a) { return lval_builtin_op(e, a, LOP_SUB); }
+lval *lval_builtin_mul(lenv *e, lval *a) { return lval_builtin_op(e, a, LOP_MUL); }
+lval *lval_builtin_div(lenv *e, lval *a) { return lval_builtin_op(e, a, LOP_DIV); }
+
+lval *lval_builtin_ord(lenv *e, lval *a, const LOP op) {
+    LASSERT_ARG_COUNT(lop_names[op], a, /*count*/2);
+    LASSERT_ARG_TYPE(lop_names[op], a, /*index*/0, /*expected*/LVAL_NUM);
+    LASSERT_ARG_TYPE(lop_names[op], a, /*index*/1, /*expected*/LVAL_NUM);
 
-lval *lval_builtin_ord(lenv *e, lval *a, const char *op) {
-    LASSERT_ARG_COUNT(op, a, /*count*/2);
-    LASSERT_ARG_TYPE(op, a, /*index*/0, /*expected*/LVAL_NUM);
-    LASSERT_ARG_TYPE(op, a, /*index*/1, /*expected*/LVAL_NUM);
+    const long x = lval_num_of(a->cell[0]);
+    const long y = lval_num_of(a->cell[1]);
 
     int result;
-    if (!strcmp(op, "<"))  result = a->cell[0]->num < a->cell[1]->num;
-    if (!strcmp(op, ">"))  result = a->cell[0]->num > a->cell[1]->num;
-    if (!strcmp(op, "<=")) result = a->cell[0]->num <= a->cell[1]->num;
-    if (!strcmp(op, ">=")) result = a->cell[0]->num >= a->cell[1]->num;
+    switch (op) {
+        case LOP_LT: result = x < y;  break;
+        case LOP_GT: result = x > y;  break;
+        case LOP_LE: result = x <= y; break;
+        case LOP_GE: result = x >= y; break;
+        default: assert(false);
+    }
 
     lval_free(a);
     return lval_num(result);
 }
 
-lval *lval_builtin_lt(lenv *e, lval *a) { return lval_builtin_ord(e, a, "<"); }
-lval *lval_builtin_gt(lenv *e, lval *a) { return lval_builtin_ord(e, a, ">"); }
-lval *lval_builtin_le(lenv *e, lval *a) { return lval_builtin_ord(e, a, "<="); }
-lval *lval_builtin_ge(lenv *e, lval *a) { return lval_builtin_ord(e, a, ">="); }
+lval *lval_builtin_lt(lenv *e, lval *a) { return lval_builtin_ord(e, a, LOP_LT); }
+lval *lval_builtin_gt(lenv *e, lval *a) { return lval_builtin_ord(e, a, LOP_GT); }
+lval *lval_builtin_le(lenv *e, lval *a) { return lval_builtin_ord(e, a, LOP_LE); }
+lval *lval_builtin_ge(lenv *e, lval *a) { return lval_builtin_ord(e, a, LOP_GE); }
 
 bool lval_equals(lval *x, lval *y) {
-    if (x->type != y->type) return false;
+    if (lval_type_of(x) != lval_type_of(y)) return false;
 
-    switch (x->type) {
-        case LVAL_NUM: return x->num == y->num;
+    switch (lval_type_of(x)) {
+        case LVAL_NUM: return lval_num_of(x) == lval_num_of(y);
 
-        case LVAL_ERR: return !strcmp(x->err, y->err);
-        case LVAL_SYM: return !strcmp(x->sym, y->sym);
-        case LVAL_STR: return !strcmp(x->str, y->str);
+        case LVAL_ERR: return x->len == y->len && !memcmp(x->err, y->err, x->len);
+        case LVAL_SYM: return x->sym == y->sym; // interned
+        case LVAL_STR: return x->len == y->len && !memcmp(x->str, y->str, x->len);
 
         case LVAL_FUN:
             if (x->builtin || y->builtin)
@@ -573,19 +1047,22 @@ bool lval_equals(lval *x, lval *y) {
     return false;
 }
 
-lval *lval_builtin_cmp(lenv *e, lval *a, const char *op) {
-    LASSERT_ARG_COUNT(op, a, /*count*/2);
+lval *lval_builtin_cmp(lenv *e, lval *a, const LOP op) {
+    LASSERT_ARG_COUNT(lop_names[op], a, /*count*/2);
 
     int result;
-    if (!strcmp(op, "==")) result =  lval_equals(a->cell[0], a->cell[1]);
-    if (!strcmp(op, "!=")) result = !lval_equals(a->cell[0], a->cell[1]);
+    switch (op) {
+        case LOP_EQ: result =  lval_equals(a->cell[0], a->cell[1]); break;
+        case LOP_NE: result = !lval_equals(a->cell[0], a->cell[1]); break;
+        default: assert(false);
+    }
 
     lval_free(a);
     return lval_num(result);
 }
 
-lval *lval_builtin_eq(lenv *e, lval *a) { return lval_builtin_cmp(e, a, "=="); }
-lval *lval_builtin_ne(lenv *e, lval *a) { return lval_builtin_cmp(e, a, "!="); }
+lval *lval_builtin_eq(lenv *e, lval *a) { return lval_builtin_cmp(e, a, LOP_EQ); }
+lval *lval_builtin_ne(lenv *e, lval *a) { return lval_builtin_cmp(e, a, LOP_NE); }
 
 lval *lval_builtin_if(lenv *e, lval *a) {
     LASSERT_ARG_COUNT("if", a, /*count*/3);
@@ -593,14 +1070,57 @@ lval *lval_builtin_if(lenv *e, lval *a) {
     LASSERT_ARG_TYPE("if", a, /*index*/1, /*expected*/LVAL_QEXPR);
     LASSERT_ARG_TYPE("if", a, /*index*/2, /*expected*/LVAL_QEXPR);
 
-    // Mark both expressions evaluable.
-    a->cell[1]->type = LVAL_SEXPR;
-    a->cell[2]->type = LVAL_SEXPR;
+    // Evaluate either expression (as is).
+    lval *x = lval_num_of(a->cell[0])    // condition
+        ? lval_eval_list(e, a->cell[1])  // true
+        : lval_eval_list(e, a->cell[2]); // false
+
+    lval_free(a);
+    return x;
+}
+
+lval *lval_builtin_logic(lenv *e, lval *a, const LOP op) {
+    // Every argument but the last is a condition, until one of them decides the result.
+    for (int i = 0; i < a->cell_count - 1; ++i) {
+        LASSERT_ARG_TYPE(lop_names[op], a, /*index*/i, /*expected*/LVAL_NUM);
+        if ((lval_num_of(a->cell[i]) != 0) == (op == LOP_OR)) return lval_take(a, i);
+    }
+
+    // Neither is true without arguments, nor false.
+    if (a->cell_count == 0) {
+        lval_free(a);
+        return lval_num(op == LOP_AND);
+    }
+    return lval_take(a, a->cell_count - 1);
+}
+
+lval *lval_logic_type_err(const LOP op, const int index, const lval *cond) {
+    return lval_err(
+        "function '%s' passed incorrect type for argument %i. Got `%s`, expected `%s`.",
+        lop_names[op], index, lval_type_name(lval_type_of(cond)), lval_type_name(LVAL_NUM));
+}
+
+lval *lval_builtin_and(lenv *e, lval *a) {
+    return lval_builtin_logic(e, a, LOP_AND);
+}
+
+lval *lval_builtin_or(lenv *e, lval *a) {
+    return lval_builtin_logic(e, a, LOP_OR);
+}
+
+lval *lval_builtin_do(lenv *e, lval *a) {
+    if (a->cell_count == 0) {
+        a->type = LVAL_QEXPR;
+        return a;
+    }
+    return lval_take(a, a->cell_count - 1);
+}
 
-    lval *x = a->cell[0]->num           // condition
-        ? lval_eval(e, lval_pop(a, 1))  // true
-        : lval_eval(e, lval_pop(a, 2)); // false
+lval *lval_builtin_let(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("let", a, /*count*/1);
+    LASSERT_ARG_TYPE("let", a, /*index*/0, /*expected*/LVAL_QEXPR);
 
+    lval *x = lval_eval_scoped(e, a->cell[0]);
     lval_free(a);
     return x;
 }
@@ -615,11 +1135,10 @@ lval *lval_builtin_head(lenv *e, lval *a) {
     LASSERT_ARG_TYPE("head", a, /*index*/0, /*expected*/LVAL_QEXPR);
     LASSERT_ARG_NOT_EMPTY("head", a, /*index*/0);
 
-    // Take the first argument.
+    // Take the first argument, and only keep its first element in view
+    // (the others are still owned by its storage, which may be shared).
     lval *v = lval_take(a, 0);
-
-    // Delete all elements that are not head and return.
-    while (v->cell_count > 1) lval_free(lval_pop(v, 1));
+    v->cell_count = 1;
     return v;
 }
 
@@ -628,11 +1147,11 @@ lval *lval_builtin_tail(lenv *e, lval *a) {
     LASSERT_ARG_TYPE("tail", a, /*index*/0, /*expected*/LVAL_QEXPR);
     LASSERT_ARG_NOT_EMPTY("tail", a, /*index*/0);
 
-    // Take the first argument.
+    // Take the first argument, and move its view of the cells past the first element
+    // (which is still owned by its storage, as it may be shared).
     lval* v = lval_take(a, 0);
-
-    // Delete the first element and return.
-    lval_free(lval_pop(v, 0));
+    v->cell++;
+    v->cell_count--;
     return v;
 }
 
@@ -640,116 +1159,428 @@ lval *lval_builtin_eval(lenv *e, lval *a) {
     LASSERT_ARG_COUNT("eval", a, /*count*/1);
     LASSERT_ARG_TYPE("eval", a, /*index*/0, /*expected*/LVAL_QEXPR);
 
-    lval *x = lval_take(a, 0);
-    x->type = LVAL_SEXPR;
-    return lval_eval(e, x);
+    lval *x = lval_eval_list(e, a->cell[0]);
+    lval_free(a);
+    return x;
 }
 
 lval *lval_builtin_join(lenv *e, lval *a) {
     for (int i = 0; i < a->cell_count; ++i)
         LASSERT_ARG_TYPE("join", a, /*index*/i, /*expected*/LVAL_QEXPR);
 
+    // Make room for every cell up front, so that `x` only grows once.
+    int count = 0;
+    for (int i = 1; i < a->cell_count; ++i) count += a->cell[i]->cell_count;
+
     lval *x = lval_pop(a, 0);
+    if (x->cell_count > 0) x = lval_reserve(x, count);
     while (a->cell_count) x = lval_join(x, lval_pop(a, 0));
 
     lval_free(a);
     return x;
 }
 
-lval *lval_builtin_var(lenv *e, lval *a, const char *fun) {
-    LASSERT_ARG_TYPE(fun, a, /*index*/0, /*expected*/LVAL_QEXPR);
+// Applies (a copy of) `f` to `x`, and to `y` unless it's NULL, as `(f x y)` would (i.e.
+// returning the first error among them, if any). Takes ownership of `x` and `y`.
+static lval *lval_apply_fun(lenv *e, lval *f, lval *x, lval *y) {
+    lval *v = lval_reserve(lval_sexpr(), y ? 3 : 2);
+    lval_add(lval_add(v, lval_copy(f)), x);
+    if (y) lval_add(v, y);
+
+    // It's a nested evaluation, as the built-in's arguments and result so far are only
+    // referenced from the native stack meanwhile (e.g. if `f` is `load`).
+    lval_eval_depth++;
+    lval *result = lval_apply(e, v);
+    lval_eval_depth--;
+    return result;
+}
 
-    // First argument is (expected to be) a symbol list.
-    lval *syms = a->cell[0];
-    for (int i = 0; i < syms->cell_count; ++i) {
-        LASSERT(
-            a, syms->cell[i]->type == LVAL_SYM,
-            "function '%s' cannot define non-symbol. Got `%s`, expected `%s`.",
-            fun, lval_type_name(syms->cell[i]->type), lval_type_name(LVAL_SYM)
-        );
-    }
+lval *lval_builtin_len(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("len", a, /*count*/1);
+    LASSERT_ARG_TYPE("len", a, /*index*/0, /*expected*/LVAL_QEXPR);
+
+    const int len = a->cell[0]->cell_count;
+    lval_free(a);
+    return lval_num(len);
+}
+
+lval *lval_builtin_nth(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("nth", a, /*count*/2);
+    LASSERT_ARG_TYPE("nth", a, /*index*/0, /*expected*/LVAL_NUM);
+    LASSERT_ARG_TYPE("nth", a, /*index*/1, /*expected*/LVAL_QEXPR);
 
+    const long n = lval_num_of(a->cell[0]);
     LASSERT(
-        a, syms->cell_count == a->cell_count - 1,
-        "function '%s' cannot define an unmatched number of values to symbols. "
-        "Got %s, expected %s.", fun, syms->cell_count, a->cell_count - 1
+        a, n >= 0 && n < a->cell[1]->cell_count,
+        "function 'nth' passed index %li, out of a list of %i items.", n, a->cell[1]->cell_count
     );
 
-    // Assign (copies of) values to symbols.
-    for (int i = 0; i < syms->cell_count; ++i) {
-        // Note that `syms` is `a->cell[0]`, hence why the `i`-th
-        // value corresponds to the `i + 1`-th symbol in `a->cell`.
+    lval *x = lval_eval_code(e, a->cell[1]->cell[n]);
+    lval_free(a);
+    return x;
+}
 
-        if (!strcmp(fun, "def"))
-            lenv_def(e, syms->cell[i], a->cell[i + 1]); // define in global scope
-        else if (!strcmp(fun, "="))
-            lenv_put(e, syms->cell[i], a->cell[i + 1]); // define in local scope
-        else
-            assert(false);
-    }
+lval *lval_builtin_last(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("last", a, /*count*/1);
+    LASSERT_ARG_TYPE("last", a, /*index*/0, /*expected*/LVAL_QEXPR);
+    LASSERT_ARG_NOT_EMPTY("last", a, /*index*/0);
 
+    lval *x = lval_eval_code(e, a->cell[0]->cell[a->cell[0]->cell_count - 1]);
     lval_free(a);
-    return lval_sexpr();
+    return x;
 }
 
-lval *lval_builtin_def(lenv *e, lval *a) { return lval_builtin_var(e, a, "def"); }
-lval *lval_builtin_put(lenv *e, lval *a) { return lval_builtin_var(e, a, "="); }
+lval *lval_builtin_map(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("map", a, /*count*/2);
+    LASSERT_ARG_TYPE("map", a, /*index*/0, /*expected*/LVAL_FUN);
+    LASSERT_ARG_TYPE("map", a, /*index*/1, /*expected*/LVAL_QEXPR);
 
-lval *lval_builtin_lambda(lenv *e, lval *a) {
-    LASSERT_ARG_COUNT("\\", a, /*count*/2);
-    LASSERT_ARG_TYPE("\\", a, /*index*/0, /*expected*/LVAL_QEXPR);
-    LASSERT_ARG_TYPE("\\", a, /*index*/1, /*expected*/LVAL_QEXPR);
+    lval *f = a->cell[0];
+    lval *lst = a->cell[1];
+
+    lval *x = lval_reserve(lval_qexpr(), lst->cell_count);
+    for (int i = 0; i < lst->cell_count; ++i) {
+        lval *y = lval_apply_fun(e, f, lval_eval_code(e, lst->cell[i]), NULL);
+        if (lval_type_of(y) == LVAL_ERR) {
+            lval_free(x);
+            x = y;
+            break;
+        }
+        lval_add(x, y);
+    }
+
+    lval_free(a);
+    return x;
+}
+
+lval *lval_builtin_filter(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("filter", a, /*count*/2);
+    LASSERT_ARG_TYPE("filter", a, /*index*/0, /*expected*/LVAL_FUN);
+    LASSERT_ARG_TYPE("filter", a, /*index*/1, /*expected*/LVAL_QEXPR);
+
+    lval *f = a->cell[0];
+    lval *lst = a->cell[1];
+
+    lval *x = lval_qexpr();
+    for (int i = 0; i < lst->cell_count; ++i) {
+        lval *keep = lval_apply_fun(e, f, lval_eval_code(e, lst->cell[i]), NULL);
+        if (lval_type_of(keep) != LVAL_NUM) {
+            lval *err = lval_type_of(keep) == LVAL_ERR ? keep : lval_err(
+                "function 'filter' passed a predicate which returned `%s`, expected `%s`.",
+                lval_type_name(lval_type_of(keep)), lval_type_name(LVAL_NUM)
+            );
+            if (err != keep) lval_free(keep);
+            lval_free(x);
+            x = err;
+            break;
+        }
+
+        // (Items are kept as they are, rather than as their values.)
+        if (lval_num_of(keep)) lval_add(x, lval_copy(lst->cell[i]));
+        lval_free(keep);
+    }
+
+    lval_free(a);
+    return x;
+}
+
+lval *lval_builtin_foldl(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("foldl", a, /*count*/3);
+    LASSERT_ARG_TYPE("foldl", a, /*index*/0, /*expected*/LVAL_FUN);
+    LASSERT_ARG_TYPE("foldl", a, /*index*/2, /*expected*/LVAL_QEXPR);
+
+    lval *f = a->cell[0];
+    lval *lst = a->cell[2];
+
+    lval *z = lval_copy(a->cell[1]);
+    for (int i = 0; i < lst->cell_count && lval_type_of(z) != LVAL_ERR; ++i)
+        z = lval_apply_fun(e, f, z, lval_eval_code(e, lst->cell[i]));
+
+    lval_free(a);
+    return z;
+}
+
+lval *lval_builtin_foldr(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("foldr", a, /*count*/3);
+    LASSERT_ARG_TYPE("foldr", a, /*index*/0, /*expected*/LVAL_FUN);
+    LASSERT_ARG_TYPE("foldr", a, /*index*/2, /*expected*/LVAL_QEXPR);
+
+    lval *f = a->cell[0];
+    lval *lst = a->cell[2];
+
+    // Every item is read (in order) before `f` is applied to any of them.
+    lval *items = lval_reserve(lval_sexpr(), lst->cell_count);
+    for (int i = 0; i < lst->cell_count; ++i) lval_add(items, lval_eval_code(e, lst->cell[i]));
+
+    lval *z = lval_copy(a->cell[1]);
+    for (int i = items->cell_count - 1; i >= 0 && lval_type_of(z) != LVAL_ERR; --i)
+        z = lval_apply_fun(e, f, lval_copy(items->cell[i]), z);
+
+    lval_free(items);
+    lval_free(a);
+    return z;
+}
+
+lval *lval_builtin_reverse(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("reverse", a, /*count*/1);
+    LASSERT_ARG_TYPE("reverse", a, /*index*/0, /*expected*/LVAL_QEXPR);
+
+    lval *lst = a->cell[0];
+    lval *x = lval_reserve(lval_qexpr(), lst->cell_count);
+    for (int i = lst->cell_count - 1; i >= 0; --i) lval_add(x, lval_copy(lst->cell[i]));
+
+    lval_free(a);
+    return x;
+}
+
+// take drop
+static lval *lval_builtin_slice(lenv *e, lval *a, const LOP op) {
+    LASSERT_ARG_COUNT(lop_names[op], a, /*count*/2);
+    LASSERT_ARG_TYPE(lop_names[op], a, /*index*/0, /*expected*/LVAL_NUM);
+    LASSERT_ARG_TYPE(lop_names[op], a, /*index*/1, /*expected*/LVAL_QEXPR);
+
+    const long n = lval_num_of(a->cell[0]);
+    LASSERT(
+        a, n >= 0 && n <= a->cell[1]->cell_count,
+        "function '%s' passed %li items, out of a list of %i.",
+        lop_names[op], n, a->cell[1]->cell_count
+    );
+
+    // Only keep a view of the items, as `head` and `tail` do.
+    lval *v = lval_take(a, 1);
+    if (op == LOP_TAKE) {
+        v->cell_count = (int)n;
+    } else {
+        v->cell += n;
+        v->cell_count -= (int)n;
+    }
+    return v;
+}
+
+lval *lval_builtin_take(lenv *e, lval *a) {
+    return lval_builtin_slice(e, a, LOP_TAKE);
+}
+
+lval *lval_builtin_drop(lenv *e, lval *a) {
+    return lval_builtin_slice(e, a, LOP_DROP);
+}
+
+lval *lval_builtin_elem(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("elem", a, /*count*/2);
+    LASSERT_ARG_TYPE("elem", a, /*index*/1, /*expected*/LVAL_QEXPR);
+
+    lval *lst = a->cell[1];
+    lval *found = lval_num(false);
+    for (int i = 0; i < lst->cell_count; ++i) {
+        lval *y = lval_eval_code(e, lst->cell[i]);
+        if (lval_type_of(y) == LVAL_ERR) {
+            found = y;
+            break;
+        }
+
+        const bool equal = lval_equals(a->cell[0], y);
+        lval_free(y);
+        if (equal) {
+            found = lval_num(true);
+            break;
+        }
+    }
+
+    lval_free(a);
+    return found;
+}
+
+lval *lval_builtin_zip(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("zip", a, /*count*/2);
+    LASSERT_ARG_TYPE("zip", a, /*index*/0, /*expected*/LVAL_QEXPR);
+    LASSERT_ARG_TYPE("zip", a, /*index*/1, /*expected*/LVAL_QEXPR);
+
+    lval *x = a->cell[0];
+    lval *y = a->cell[1];
+    const int count = x->cell_count < y->cell_count ? x->cell_count : y->cell_count;
+
+    lval *pairs = lval_reserve(lval_qexpr(), count);
+    for (int i = 0; i < count; ++i) {
+        lval *pair = lval_reserve(lval_qexpr(), 2);
+        lval_add(lval_add(pair, lval_copy(x->cell[i])), lval_copy(y->cell[i]));
+        lval_add(pairs, pair);
+    }
+
+    lval_free(a);
+    return pairs;
+}
+
+lval *lval_builtin_unzip(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("unzip", a, /*count*/1);
+    LASSERT_ARG_TYPE("unzip", a, /*index*/0, /*expected*/LVAL_QEXPR);
+
+    lval *lst = a->cell[0];
+    lval *firsts = lval_reserve(lval_qexpr(), lst->cell_count);
+    lval *rests = lval_reserve(lval_qexpr(), lst->cell_count);
+
+    // The first item of each pair goes to `firsts`, and the others to `rests`.
+    for (int i = 0; i < lst->cell_count; ++i) {
+        lval *pair = lval_eval_code(e, lst->cell[i]);
+        if (lval_type_of(pair) != LVAL_QEXPR || pair->cell_count == 0) {
+            lval *err = lval_type_of(pair) == LVAL_ERR ? pair : lval_err(
+                "function 'unzip' passed `%s` as item %i, expected a non-empty `%s`.",
+                lval_type_name(lval_type_of(pair)), i, lval_type_name(LVAL_QEXPR)
+            );
+            if (err != pair) lval_free(pair);
+            lval_free(firsts);
+            lval_free(rests);
+            lval_free(a);
+            return err;
+        }
+
+        lval_add(firsts, lval_copy(pair->cell[0]));
+        for (int j = 1; j < pair->cell_count; ++j) lval_add(rests, lval_copy(pair->cell[j]));
+        lval_free(pair);
+    }
+
+    lval_free(a);
+    return lval_add(lval_add(lval_reserve(lval_qexpr(), 2), firsts), rests);
+}
+
+lval *lval_builtin_var(lenv *e, lval *a, const LOP op) {
+    LASSERT_ARG_TYPE(lop_names[op], a, /*index*/0, /*expected*/LVAL_QEXPR);
+
+    // First argument is (expected to be) a symbol list.
+    lval *syms = a->cell[0];
+    for (int i = 0; i < syms->cell_count; ++i) {
+        LASSERT(
+            a, lval_type_of(syms->cell[i]) == LVAL_SYM,
+            "function '%s' cannot define non-symbol. Got `%s`, expected `%s`.",
+            lop_names[op], lval_type_name(lval_type_of(syms->cell[i])), lval_type_name(LVAL_SYM)
+        );
+        LASSERT(
+            a, !lsym_is_const(syms->cell[i]->sym),
+            "function '%s' cannot redefine constant '%s'.", lop_names[op], syms->cell[i]->sym
+        );
+    }
+
+    LASSERT(
+        a, syms->cell_count == a->cell_count - 1,
+        "function '%s' cannot define an unmatched number of values to symbols. "
+        "Got %i, expected %i.", lop_names[op], syms->cell_count, a->cell_count - 1
+    );
+
+    // Assign (copies of) values to symbols.
+    for (int i = 0; i < syms->cell_count; ++i) {
+        // Note that `syms` is `a->cell[0]`, hence why the `i`-th
+        // value corresponds to the `i + 1`-th symbol in `a->cell`.
+
+        switch (op) {
+            case LOP_DEF: lenv_def(e, syms->cell[i], a->cell[i + 1]); break; // global scope
+            case LOP_CONST:
+                lenv_def(e, syms->cell[i], a->cell[i + 1]);
+                lsym_set_const(syms->cell[i]->sym);
+                break;
+            case LOP_PUT: lenv_put(e, syms->cell[i], a->cell[i + 1]); break; // local scope
+            default: assert(false);
+        }
+    }
+
+    lval_free(a);
+    return lval_sexpr();
+}
+
+lval *lval_builtin_def(lenv *e, lval *a) { return lval_builtin_var(e, a, LOP_DEF); }
+lval *lval_builtin_const(lenv *e, lval *a) { return lval_builtin_var(e, a, LOP_CONST); }
+lval *lval_builtin_put(lenv *e, lval *a) { return lval_builtin_var(e, a, LOP_PUT); }
+
+// Gives each symbol in `body` (and in its nested expressions) which is one of `formals`
+// the slot it will be bound to, since `lval_call` binds them in order (except for '&').
+static void lval_resolve(lval *body, const lval *formals) {
+    for (int i = 0; i < body->cell_count; ++i) {
+        lval *x = body->cell[i];
+
+        switch (lval_type_of(x)) {
+            case LVAL_SYM:
+                for (int j = 0, slot = 0; j < formals->cell_count; ++j) {
+                    if (formals->cell[j]->sym == x->sym) {
+                        x->slot = slot;
+                        break;
+                    }
+                    if (!lval_is_rest(formals->cell[j])) slot++;
+                }
+                break;
+
+            case LVAL_SEXPR:
+            case LVAL_QEXPR:
+                lval_resolve(x, formals);
+                break;
+
+            default: break;
+        }
+    }
+}
+
+lval *lval_builtin_lambda(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("\\", a, /*count*/2);
+    LASSERT_ARG_TYPE("\\", a, /*index*/0, /*expected*/LVAL_QEXPR);
+    LASSERT_ARG_TYPE("\\", a, /*index*/1, /*expected*/LVAL_QEXPR);
 
     // Check if the first Q-Expression only contains symbols.
     for (int i = 0; i < a->cell[0]->cell_count; ++i) {
         LASSERT(
-            a, a->cell[0]->cell[i]->type == LVAL_SYM,
+            a, lval_type_of(a->cell[0]->cell[i]) == LVAL_SYM,
             "cannot define non-symbol. Got `%s`, expected `%s`.",
-            lval_type_name(a->cell[0]->cell[i]->type), lval_type_name(LVAL_SYM)
+            lval_type_name(lval_type_of(a->cell[0]->cell[i])), lval_type_name(LVAL_SYM)
+        );
+        LASSERT(
+            a, !lsym_is_const(a->cell[0]->cell[i]->sym),
+            "cannot bind constant '%s'.", a->cell[0]->cell[i]->sym
         );
     }
 
     lval *formals = lval_pop(a, 0);
-    lval *body = lval_pop(a, 0);
+    lval *body = lfold_body(e, lval_pop(a, 0));
     lval_free(a);
 
-    return lval_lambda(formals, body);
-}
+    lval_resolve(body, formals);
+    if (lmemo_auto) body->memo = lmemo_is_pure(formals, body);
 
-lval *lval_builtin_load(lenv *e, lval *a) {
-    LASSERT_ARG_COUNT("load", a, /*count*/1);
-    LASSERT_ARG_TYPE("load", a, /*index*/0, /*expected*/LVAL_STR);
+    // Capture the environment in which the function is defined
+    // (unless it's the global one, which is always looked up last anyway).
+    lval *f = lval_lambda(formals, body);
+    if (e->global_ref) {
+        f->env->parent_ref = e;
+        e->refs++;
+    }
 
-    // Parse the file given by string name.
-    mpc_result_t r;
-    if (mpc_parse_contents(a->cell[0]->str, Lispy, &r)) {
-        // Read contents.
-        lval *expr = lval_read(r.output);
-        mpc_ast_delete(r.output);
+    return f;
+}
 
-        // Evaluate each expression (and print possible errors).
-        while (expr->cell_count) {
-            lval *x = lval_eval(e, lval_pop(expr, 0));
-            if (x->type == LVAL_ERR) lval_println(x);
-            lval_free(x);
-        }
+lval *lval_builtin_memo(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("memo", a, /*count*/1);
+    LASSERT_ARG_TYPE("memo", a, /*index*/0, /*expected*/LVAL_FUN);
+    LASSERT(a, !a->cell[0]->builtin, "function 'memo' passed a built-in function.");
 
-        // Cleanup and return an empty list.
-        lval_free(expr);
-        lval_free(a);
-        return lval_sexpr();
-    }
+    // Share everything with `f` but its body, which is marked (as `f` is never modified).
+    const lval *f = a->cell[0];
+    lval *body = lval_copy(f->body);
+    body->memo = true;
 
-    // Get parse error as string.
-    char *err_msg = mpc_err_string(r.error);
-    mpc_err_delete(r.error);
+    lval *memo = lval_lambda(lval_copy(f->formals), body);
+    lenv_free(memo->env);
+    memo->env = lenv_copy(f->env);
 
-    lval *err = lval_err("Could not load library %s", err_msg);
+    lval_free(a);
+    return memo;
+}
 
-    // Cleanup and return an error.
-    free(err_msg);
+lval *lval_builtin_load(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("load", a, /*count*/1);
+    LASSERT_ARG_TYPE("load", a, /*index*/0, /*expected*/LVAL_STR);
+
+    // Parse the file given by string name.
+    lval *forms = lval_read_file(a->cell[0]->str);
     lval_free(a);
-    return err;
+    if (lval_type_of(forms) == LVAL_ERR) return forms;
+
+    lval_eval_forms(e, forms);
+    return lval_sexpr();
 }
 
 lval *lval_builtin_print(lenv *e, lval *a) {
@@ -773,18 +1604,156 @@ lval *lval_builtin_error(lenv *e, lval *a) {
     return err;
 }
 
+// Creates a `{"name" value}` pair, as returned by the statistics built-ins.
+static lval *lval_stat(const char *name, const unsigned long value) {
+    return lval_add(lval_add(lval_qexpr(), lval_str(name)), lval_num((long)value));
+}
+
+lval *lval_builtin_pool_stats(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("pool-stats", a, /*count*/1);
+    LASSERT_ARG_TYPE("pool-stats", a, /*index*/0, /*expected*/LVAL_STR);
+
+    const char *name = a->cell[0]->str;
+    lpool p = { 0 };
+
+    if (!strcmp(name, "lval")) {
+        p = lval_pool;
+    } else if (!strcmp(name, "lenv")) {
+        p = lenv_pool;
+    } else if (!strcmp(name, "cells")) {
+        // Sum up all of the size classes.
+        for (int i = 0; i < LCELLS_CLASSES; ++i) {
+            p.allocs += lcells_pools[i].allocs;
+            p.hits += lcells_pools[i].hits;
+            p.live += lcells_pools[i].live;
+            p.slab_count += lcells_pools[i].slab_count;
+        }
+    } else {
+        lval *err = lval_err(
+            "function 'pool-stats' passed unknown pool \"%s\". "
+            "Expected \"lval\", \"lenv\" or \"cells\".", name
+        );
+        lval_free(a);
+        return err;
+    }
+
+    lval *stats = lval_qexpr();
+    stats = lval_add(stats, lval_stat("allocs", p.allocs));
+    stats = lval_add(stats, lval_stat("hits", p.hits));
+    stats = lval_add(stats, lval_stat("live", p.live));
+    stats = lval_add(stats, lval_stat("slabs", p.slab_count));
+    if (!strcmp(name, "cells"))
+        stats = lval_add(stats, lval_stat("large", lcells_large_allocs));
+
+    lval_free(a);
+    return stats;
+}
+
+lval *lval_builtin_gc_stats(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("gc-stats", a, /*count*/1);
+    LASSERT_ARG_TYPE("gc-stats", a, /*index*/0, /*expected*/LVAL_NUM);
+
+    lval *stats = lval_qexpr();
+    stats = lval_add(stats, lval_stat("threshold", lgc.threshold));
+    stats = lval_add(stats, lval_stat("collections", lgc.collections));
+    stats = lval_add(stats, lval_stat("pause-us", lgc.pause_us));
+    stats = lval_add(stats, lval_stat("max-pause-us", lgc.max_pause_us));
+    stats = lval_add(stats, lval_stat("objects-reclaimed", lgc.objects_reclaimed));
+    stats = lval_add(stats, lval_stat("bytes-reclaimed", lgc.bytes_reclaimed));
+
+    // Reset the statistics (but not the threshold), if asked to.
+    if (lval_num_of(a->cell[0])) lgc = (lgc_stats){ .threshold = lgc.threshold };
+
+    lval_free(a);
+    return stats;
+}
+
+lval *lval_builtin_fold_stats(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("fold-stats", a, /*count*/1);
+    LASSERT_ARG_TYPE("fold-stats", a, /*index*/0, /*expected*/LVAL_NUM);
+
+    lval *stats = lval_qexpr();
+    stats = lval_add(stats, lval_stat("folded", lfold.folded));
+    stats = lval_add(stats, lval_stat("inlined", lfold.inlined));
+
+    // Reset the statistics, if asked to.
+    if (lval_num_of(a->cell[0])) lfold = (lfold_stats){ 0 };
+
+    lval_free(a);
+    return stats;
+}
+
+lval *lval_builtin_gc_threshold(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("gc-threshold", a, /*count*/1);
+    LASSERT_ARG_TYPE("gc-threshold", a, /*index*/0, /*expected*/LVAL_NUM);
+    LASSERT(
+        a, lval_num_of(a->cell[0]) >= 0,
+        "function 'gc-threshold' passed a negative threshold."
+    );
+
+    const unsigned long previous = lgc.threshold;
+    lgc.threshold = lval_num_of(a->cell[0]);
+
+    lval_free(a);
+    return lval_num((long)previous);
+}
+
+lval *lval_builtin_max_depth(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("max-depth", a, /*count*/1);
+    LASSERT_ARG_TYPE("max-depth", a, /*index*/0, /*expected*/LVAL_NUM);
+    LASSERT(
+        a, lval_num_of(a->cell[0]) > 0 && lval_num_of(a->cell[0]) <= INT_MAX,
+        "function 'max-depth' passed an invalid depth."
+    );
+
+    const int previous = lval_max_depth;
+    lval_max_depth = (int)lval_num_of(a->cell[0]);
+
+    lval_free(a);
+    return lval_num(previous);
+}
+
+lval *lval_builtin_memo_stats(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("memo-stats", a, /*count*/1);
+    LASSERT_ARG_TYPE("memo-stats", a, /*index*/0, /*expected*/LVAL_NUM);
+
+    lval *stats = lval_qexpr();
+    stats = lval_add(stats, lval_stat("limit", lmemo.capacity));
+    stats = lval_add(stats, lval_stat("entries", lmemo.entries));
+    stats = lval_add(stats, lval_stat("hits", lmemo.hits));
+    stats = lval_add(stats, lval_stat("misses", lmemo.misses));
+    stats = lval_add(stats, lval_stat("evictions", lmemo.evictions));
+
+    // Reset the counters, if asked to.
+    if (lval_num_of(a->cell[0])) lmemo.hits = lmemo.misses = lmemo.evictions = 0;
+
+    lval_free(a);
+    return stats;
+}
+
+lval *lval_builtin_memo_limit(lenv *e, lval *a) {
+    LASSERT_ARG_COUNT("memo-limit", a, /*count*/1);
+    LASSERT_ARG_TYPE("memo-limit", a, /*index*/0, /*expected*/LVAL_NUM);
+    LASSERT(
+        a, lval_num_of(a->cell[0]) >= 0,
+        "function 'memo-limit' passed a negative limit."
+    );
+
+    const unsigned long previous = lmemo.capacity;
+    lmemo_set_capacity(lval_num_of(a->cell[0]));
+
+    lval_free(a);
+    return lval_num((long)previous);
+}
+
 //
 // Eval.
 //
 
-lval *lval_eval_sexpr(lenv *e, lval *v) {
-    // Evaluate children.
-    for (int i = 0; i < v->cell_count; ++i)
-        v->cell[i] = lval_eval(e, v->cell[i]);
-
+lval *lval_apply(lenv *e, lval *v) {
     // Error checking.
     for (int i = 0; i < v->cell_count; ++i)
-        if (v->cell[i]->type == LVAL_ERR) return lval_take(v, i);
+        if (lval_type_of(v->cell[i]) == LVAL_ERR) return lval_take(v, i);
 
     // Empty expression.
     if (v->cell_count == 0) return v;
@@ -794,10 +1763,10 @@ lval *lval_eval_sexpr(lenv *e, lval *v) {
 
     // Ensure the first element is a function after evaluation.
     lval *f = lval_pop(v, 0);
-    if (f->type != LVAL_FUN) {
+    if (lval_type_of(f) != LVAL_FUN) {
         lval *err = lval_err(
             "S-Expression starting with incorrect type. "
-            "Got `%s`, expected `%s`.", lval_type_name(f->type), lval_type_name(LVAL_FUN)
+            "Got `%s`, expected `%s`.", lval_type_name(lval_type_of(f)), lval_type_name(LVAL_FUN)
         );
         lval_free(f);
         lval_free(v);
@@ -811,25 +1780,310 @@ lval *lval_eval_sexpr(lenv *e, lval *v) {
     return result;
 }
 
-lval *lval_eval(lenv *e, lval *v) {
-    // Evaluate symbols.
-    if (v->type == LVAL_SYM) {
-        lval *x = lenv_get(e, v);
-        lval_free(v);
-        return x;
+lval *lval_check_depth(void) {
+    if (lval_eval_depth >= LVAL_MAX_NATIVE_DEPTH)
+        return lval_err("maximum depth of nested evaluations (%i) exceeded", LVAL_MAX_NATIVE_DEPTH);
+    if (lval_eval_depth + lvm_frame_count + lval_kept_frames >= lval_max_depth)
+        return lval_err("maximum depth of evaluation (%i) exceeded", lval_max_depth);
+    return NULL;
+}
+
+// Evaluates the expression `v` in tail position, i.e. returns NULL after setting `*tail` to
+// it if it's an S-Expression (whose cells are then evaluated by the caller instead).
+static lval *lval_eval_last(lenv *e, lval *v, lval **tail) {
+    if (lval_type_of(v) != LVAL_SEXPR) return lval_eval_code(e, v);
+    *tail = v;
+    return NULL;
+}
+
+// Evaluates the special form `op`, called by `code`, except for its expression in tail
+// position (if it's a list), which is returned in `*tail` instead (see `lval_eval_last`).
+// Returns NULL (leaving `*tail` as is) if it isn't called as such (e.g. the branches of an
+// `if` are missing, or aren't literal Q-Expressions), i.e. if it's called like a function.
+static lval *lval_eval_special(lenv *e, const LOP op, lval *code, lval **tail) {
+    switch (op) {
+        case LOP_IF: {
+            if (code->cell_count != 4 || lval_type_of(code->cell[2]) != LVAL_QEXPR
+                || lval_type_of(code->cell[3]) != LVAL_QEXPR) return NULL;
+
+            lval *cond = lval_eval_code(e, code->cell[1]);
+            if (lval_type_of(cond) != LVAL_NUM) {
+                if (lval_type_of(cond) == LVAL_ERR) return cond;
+
+                // Let `if` report it.
+                lval *a = lval_add(lval_sexpr(), cond);
+                lval_add(a, lval_copy(code->cell[2]));
+                return lval_builtin_if(e, lval_add(a, lval_copy(code->cell[3])));
+            }
+
+            *tail = code->cell[lval_num_of(cond) ? 2 : 3];
+            lval_free(cond);
+            return NULL;
+        }
+
+        case LOP_AND:
+        case LOP_OR: {
+            lval *x = NULL;
+            for (int i = 1; i < code->cell_count; ++i) {
+                if (i == code->cell_count - 1) return lval_eval_last(e, code->cell[i], tail);
+
+                x = lval_eval_code(e, code->cell[i]);
+                if (lval_type_of(x) == LVAL_ERR) break;
+
+                if (lval_type_of(x) != LVAL_NUM) {
+                    lval *err = lval_logic_type_err(op, i - 1, x);
+                    lval_free(x);
+                    return err;
+                }
+
+                if ((lval_num_of(x) != 0) == (op == LOP_OR)) break;
+                lval_free(x);
+            }
+            return x;
+        }
+
+        case LOP_DO: {
+            for (int i = 1; i < code->cell_count - 1; ++i) {
+                lval *x = lval_eval_code(e, code->cell[i]);
+                if (lval_type_of(x) == LVAL_ERR) return x;
+                lval_free(x);
+            }
+            return lval_eval_last(e, code->cell[code->cell_count - 1], tail);
+        }
+
+        case LOP_LET:
+            if (code->cell_count != 2 || lval_type_of(code->cell[1]) != LVAL_QEXPR) return NULL;
+            return lval_eval_scoped(e, code->cell[1]);
+
+        default:
+            return NULL;
     }
+}
 
-    // Evaluate S-expressions.
-    if (v->type == LVAL_SEXPR) return lval_eval_sexpr(e, v);
+// Whether the (evaluated) S-Expression `v` calls a lambda, on arguments none of which is an
+// error.
+static bool lval_is_tail_call(const lval *v) {
+    if (v->cell_count < 2) return false;
+    if (lval_type_of(v->cell[0]) != LVAL_FUN || v->cell[0]->builtin) return false;
 
-    // All other lval types remain the same.
-    return v;
+    for (int i = 1; i < v->cell_count; ++i)
+        if (lval_type_of(v->cell[i]) == LVAL_ERR) return false;
+    return true;
+}
+
+// Evaluates the cells of `code` (without modifying them) into a new S-Expression, then
+// applies it. Unless it calls a special form by name, which evaluates them itself.
+//
+// Then, the value of whatever expression is in tail position (i.e. that of a special form,
+// or the code passed to `eval`) is evaluated in turn, rather than recursively. So is that
+// of a call to a lambda if `call` isn't NULL (see `lval_eval_tail`).
+static lval *lval_eval_cells(lenv *e, lval *code, lval **call) {
+    lval *owned = NULL; // (code built at runtime, and passed to `eval`)
+    lval *result = NULL;
+
+    while (!result) {
+        lval *tail = NULL;
+        lval *v = lval_reserve(lval_sexpr(), code->cell_count);
+        for (int i = 0; i < code->cell_count; ++i) {
+            lval *x = lval_eval_code(e, code->cell[i]);
+
+            if (i == 0 && code->cell_count > 1 && lval_type_of(code->cell[0]) == LVAL_SYM
+                && lval_type_of(x) == LVAL_FUN && x->builtin && lop_is_special(x->op)) {
+                result = lval_eval_special(e, x->op, code, &tail);
+                if (result || tail) {
+                    lval_free(x);
+                    break;
+                }
+            }
+
+            lval_add(v, x);
+        }
+
+        if (result || tail) {
+            lval_free(v);
+            code = tail;
+            continue;
+        }
+
+        // `(eval {code})`, whose code is evaluated in place of the call.
+        if (v->cell_count == 2 && lval_type_of(v->cell[0]) == LVAL_FUN && v->cell[0]->builtin
+            && v->cell[0]->op == LOP_EVAL && lval_type_of(v->cell[1]) == LVAL_QEXPR) {
+            // (Its code is only referenced from here meanwhile, so that's a nested evaluation.)
+            if (owned) lval_free(owned);
+            else lval_eval_depth++;
+            owned = code = lval_pop(v, 1);
+            lval_free(v);
+            continue;
+        }
+
+        if (call && lval_is_tail_call(v)) {
+            *call = v;
+            break;
+        }
+
+        result = lval_apply(e, v);
+    }
+
+    if (owned) {
+        lval_free(owned);
+        lval_eval_depth--;
+    }
+    return result;
+}
+
+lval *lval_eval_list(lenv *e, lval *code) {
+    return lval_eval_tail(e, code, NULL);
+}
+
+lval *lval_eval_tail(lenv *e, lval *code, lval **call) {
+    lval_eval_depth++;
+
+    // (Unless it's nested too deeply.)
+    lval *x = lval_check_depth();
+    if (!x) x = lval_eval_cells(e, code, call);
+
+    lval_eval_depth--;
+    return x;
+}
+
+lval *lval_eval_code(lenv *e, lval *v) {
+    switch (lval_type_of(v)) {
+        case LVAL_SYM:   return lenv_get(e, v);
+        case LVAL_SEXPR: return lval_eval_list(e, v);
+        default:         return lval_copy(v); // (all other lval types remain the same)
+    }
+}
+
+lval *lval_eval_sexpr(lenv *e, lval *v) {
+    lval *x = lval_eval_list(e, v);
+    lval_free(v);
+    return x;
+}
+
+lval *lval_eval_scoped(lenv *e, lval *body) {
+    lenv *frame = lenv_push_frame(&(lenv){ 0 });
+    frame->caller_ref = e;
+    frame->global_ref = e->global_ref ? e->global_ref : e;
+
+    lval *x = lvm_enabled ? lvm_run(frame, body) : lval_eval_list(frame, body);
+
+    lenv_pop_frame();
+    return x;
+}
+
+// Lists of top-level expressions being evaluated (see `lval_eval_forms`), which are
+// only reachable from here, and of which there are `lval_forms_count`.
+static lval **lval_forms = NULL;
+static int lval_forms_size = 0;
+static int lval_forms_count = 0;
+
+void lval_eval_forms(lenv *e, lval *forms) {
+    if (lval_forms_count == lval_forms_size) {
+        lval_forms_size = lval_forms_size ? 2 * lval_forms_size : 8;
+        lval_forms = realloc(lval_forms, lval_forms_size * sizeof(lval *));
+    }
+    lval_forms[lval_forms_count++] = forms;
+
+    // Evaluate each expression (and print possible errors). They're kept in `forms` while
+    // they're evaluated, as evaluation doesn't consume them.
+    const bool top_level = lval_top_level;
+    lval_unshare_cells(forms);
+    for (int i = 0; i < forms->cell_count; ++i) {
+        forms->cell[i] = lfold_expr(e, forms->cell[i]);
+
+        lval_top_level = false;
+        lval *x = lval_eval_code(e, forms->cell[i]);
+        lval_top_level = top_level;
+        if (lval_type_of(x) == LVAL_ERR) lval_println(x);
+        lval_free(x);
+
+        // In between top-level expressions, everything that is in use can be reached from
+        // the environment or from the expressions of the files being loaded, so it's a safe
+        // point for collecting garbage. (Whereas the expression which loads a file may still
+        // be using values only referenced from the native stack, e.g. its arguments.)
+        if (top_level) lgc_maybe_collect(e, lval_forms, lval_forms_count);
+    }
+
+    lval_forms_count--;
+    lval_free(forms);
+}
+
+lval *lval_eval(lenv *e, lval *v) {
+    if (lval_type_of(v) != LVAL_SYM && lval_type_of(v) != LVAL_SEXPR) return v;
+
+    lval *x = lval_eval_code(e, v);
+    lval_free(v);
+    return x;
 }
 
 //
 // Read.
 //
 
+mpc_parser_t *Lispy;
+
+// Parsers of the rules of the grammar (other than `Lispy` itself).
+static mpc_parser_t *Number;
+static mpc_parser_t *Symbol;
+static mpc_parser_t *String;
+static mpc_parser_t *Comment;
+static mpc_parser_t *Sexpr;
+static mpc_parser_t *Qexpr;
+static mpc_parser_t *Expr;
+
+#define PARSERS_COUNT 8
+#define PARSERS_COMMA_SEPARATED \
+    Number, Symbol, String, Comment, Sexpr, Qexpr, Expr, Lispy
+
+void lval_parser_new(void) {
+    Lispy   = mpc_new("lispy");
+    Number  = mpc_new("number");
+    Symbol  = mpc_new("symbol"); // a-z A-Z 0-9 _+-*/\=<>!&
+    String  = mpc_new("string");
+    Comment = mpc_new("comment");
+    Sexpr   = mpc_new("sexpr"); // S(ymbol)-Expression
+    Qexpr   = mpc_new("qexpr"); // Q(uoted)-Expression
+    Expr    = mpc_new("expr");
+
+    mpca_lang(MPCA_LANG_DEFAULT,
+        "                                                       \
+            number  : /-?[0-9]+/ ;                              \
+            symbol  : /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+/ ;        \
+            string  : /\"(\\\\.|[^\"])*\"/ ;                    \
+            comment : /;[^\\r\\n]*/ ;                           \
+            sexpr   : '(' <expr>* ')' ;                         \
+            qexpr   : '{' <expr>* '}' ;                         \
+            expr    : <number> | <symbol>                       \
+                    | <string> | <comment>                      \
+                    | <sexpr>  | <qexpr> ;                      \
+            lispy   : /^/ <expr>* /$/ ;                         \
+        ",
+        PARSERS_COMMA_SEPARATED
+    );
+}
+
+void lval_parser_delete(void) {
+    // Undefine and delete parsers.
+    mpc_cleanup(PARSERS_COUNT, PARSERS_COMMA_SEPARATED);
+}
+
+lval *lval_read_file(const char *path) {
+    mpc_result_t r;
+    if (mpc_parse_contents(path, Lispy, &r)) {
+        lval *forms = lval_read(r.output);
+        mpc_ast_delete(r.output);
+        return forms;
+    }
+
+    // Get parse error as string.
+    char *err_msg = mpc_err_string(r.error);
+    mpc_err_delete(r.error);
+
+    lval *err = lval_err("Could not load library %s", err_msg);
+    free(err_msg);
+    return err;
+}
+
 lval *lval_read_num(const mpc_ast_t *t) {
     errno = 0;
     const long x = strtol(t->contents, NULL, 10);
@@ -840,11 +2094,12 @@ lval *lval_read_num(const mpc_ast_t *t) {
 
 lval *lval_read_str(const mpc_ast_t *t) {
     // Remove the trailing quote character.
-    t->contents[strlen(t->contents) - 1] = '\0';
+    const size_t len = strlen(t->contents);
+    t->contents[len - 1] = '\0';
 
     // Ignore the leading quote character.
-    char *unescaped_str = malloc(strlen(t->contents + 1) + 1);
-    strcpy(unescaped_str, t->contents + 1);
+    char *unescaped_str = malloc(len - 1);
+    memcpy(unescaped_str, t->contents + 1, len - 1);
 
     // Unescaped special characters and construct a new lval.
     unescaped_str = mpcf_unescape(unescaped_str);
@@ -866,6 +2121,9 @@ lval *lval_read(const mpc_ast_t *t) {
     if (strstr(t->tag, "sexpr")) x = lval_sexpr();
     if (strstr(t->tag, "qexpr")) x = lval_qexpr();
 
+    // (At most every child is an expression, so allocate the cells only once.)
+    x = lval_reserve(x, t->children_num);
+
     // Fill this list with any valid expression contained within.
     for (int i = 0; i < t->children_num; ++i) {
         if (!strcmp(t->children[i]->contents, "(")) continue;
@@ -904,8 +2162,8 @@ void lval_print_expr(const lval *v, const char open, const char close) {
 }
 
 void lval_print_str(const lval *v) {
-    char *escaped_str = malloc(strlen(v->str) + 1);
-    strcpy(escaped_str, v->str);
+    char *escaped_str = malloc(v->len + 1);
+    memcpy(escaped_str, v->str, v->len + 1);
 
     // Escape special characters and print it between quotes.
     escaped_str = mpcf_escape(escaped_str);
@@ -915,8 +2173,8 @@ void lval_print_str(const lval *v) {
 }
 
 void lval_print(const lval *v) {
-    switch (v->type) {
-        case LVAL_NUM:      printf("%li", v->num);        break;
+    switch (lval_type_of(v)) {
+        case LVAL_NUM:      printf("%li", lval_num_of(v)); break;
         case LVAL_ERR:      printf("Error: %s", v->err);  break;
         case LVAL_SYM:      printf("%s", v->sym);         break;
         case LVAL_STR:      lval_print_str(v);            break;
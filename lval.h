@@ -2,20 +2,30 @@
 #define __CLISP_LVAL_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "ext/mpc.h"
 
+#include "mem.h"
+
 extern mpc_parser_t *Lispy;
 
 // Forward declarations.
 struct lval;
 struct lenv;
+struct lcells;
+struct lcode;
 typedef struct lval lval;
 typedef struct lenv lenv;
+typedef struct lcells lcells;
+typedef struct lcode lcode;
 
 // Max size for an error message.
 #define MAX_ERR_LEN 511
 
+// Max length for a string (or error message) to be stored inline, i.e. within the lval.
+#define LVAL_SHORT_STR_LEN 19
+
 // Valid types for a lval.
 typedef enum {
     LVAL_NUM, LVAL_ERR, LVAL_SYM, LVAL_STR,
@@ -25,44 +35,238 @@ typedef enum {
 // Pointer to a built-in lval function.
 typedef lval *(*lbuiltin)(lenv *, lval *);
 
+// Table of the built-in functions, as `X(name, opcode, function, pure)` entries, from
+// which their opcodes are generated, and with which `lenv_add_builtins` registers them.
+// Pure built-ins have no side effects, so calls to them can be folded (see fold.h).
+#define LBUILTINS(X) LBUILTINS_CORE(X) LBUILTINS_LISTS(X)
+
+#define LBUILTINS_CORE(X)                                                       \
+    X("\\",           LOP_LAMBDA,       lval_builtin_lambda,       false)       \
+    X("memo",         LOP_MEMO,         lval_builtin_memo,         false)       \
+    X("def",          LOP_DEF,          lval_builtin_def,          false)       \
+    X("const",        LOP_CONST,        lval_builtin_const,        false)       \
+    X("=",            LOP_PUT,          lval_builtin_put,          false)       \
+                                                                                \
+    X("list",         LOP_LIST,         lval_builtin_list,         true )       \
+    X("head",         LOP_HEAD,         lval_builtin_head,         true )       \
+    X("tail",         LOP_TAIL,         lval_builtin_tail,         true )       \
+    X("eval",         LOP_EVAL,         lval_builtin_eval,         false)       \
+    X("join",         LOP_JOIN,         lval_builtin_join,         true )       \
+                                                                                \
+    X("+",            LOP_ADD,          lval_builtin_add,          true )       \
+    X("-",            LOP_SUB,          lval_builtin_sub,          true )       \
+    X("*",            LOP_MUL,          lval_builtin_mul,          true )       \
+    X("/",            LOP_DIV,          lval_builtin_div,          true )       \
+                                                                                \
+    X("<",            LOP_LT,           lval_builtin_lt,           true )       \
+    X(">",            LOP_GT,           lval_builtin_gt,           true )       \
+    X("<=",           LOP_LE,           lval_builtin_le,           true )       \
+    X(">=",           LOP_GE,           lval_builtin_ge,           true )       \
+                                                                                \
+    X("==",           LOP_EQ,           lval_builtin_eq,           true )       \
+    X("!=",           LOP_NE,           lval_builtin_ne,           true )       \
+                                                                                \
+    X("if",           LOP_IF,           lval_builtin_if,           false)       \
+    X("and",          LOP_AND,          lval_builtin_and,          true )       \
+    X("or",           LOP_OR,           lval_builtin_or,           true )       \
+    X("do",           LOP_DO,           lval_builtin_do,           true )       \
+    X("let",          LOP_LET,          lval_builtin_let,          false)       \
+                                                                                \
+    X("load",         LOP_LOAD,         lval_builtin_load,         false)       \
+    X("print",        LOP_PRINT,        lval_builtin_print,        false)       \
+    X("error",        LOP_ERROR,        lval_builtin_error,        false)       \
+                                                                                \
+    X("pool-stats",   LOP_POOL_STATS,   lval_builtin_pool_stats,   false)       \
+    X("gc-stats",     LOP_GC_STATS,     lval_builtin_gc_stats,     false)       \
+    X("fold-stats",   LOP_FOLD_STATS,   lval_builtin_fold_stats,   false)       \
+    X("gc-threshold", LOP_GC_THRESHOLD, lval_builtin_gc_threshold, false)       \
+    X("max-depth",    LOP_MAX_DEPTH,    lval_builtin_max_depth,    false)       \
+    X("memo-stats",   LOP_MEMO_STATS,   lval_builtin_memo_stats,   false)       \
+    X("memo-limit",   LOP_MEMO_LIMIT,   lval_builtin_memo_limit,   false)
+
+// Native versions of the list functions of the prelude, which replace its definitions once
+// it's loaded (see `lenv_add_list_builtins`). Like them, they can still be redefined, and
+// items are evaluated when they're read as values (as by `fst`).
+#define LBUILTINS_LISTS(X)                                                      \
+    X("len",          LOP_LEN,          lval_builtin_len,          false)       \
+    X("nth",          LOP_NTH,          lval_builtin_nth,          false)       \
+    X("last",         LOP_LAST,         lval_builtin_last,         false)       \
+    X("map",          LOP_MAP,          lval_builtin_map,          false)       \
+    X("filter",       LOP_FILTER,       lval_builtin_filter,       false)       \
+    X("foldl",        LOP_FOLDL,        lval_builtin_foldl,        false)       \
+    X("foldr",        LOP_FOLDR,        lval_builtin_foldr,        false)       \
+    X("reverse",      LOP_REVERSE,      lval_builtin_reverse,      false)       \
+    X("take",         LOP_TAKE,         lval_builtin_take,         false)       \
+    X("drop",         LOP_DROP,         lval_builtin_drop,         false)       \
+    X("elem",         LOP_ELEM,         lval_builtin_elem,         false)       \
+    X("zip",          LOP_ZIP,          lval_builtin_zip,          false)       \
+    X("unzip",        LOP_UNZIP,        lval_builtin_unzip,        false)
+
+// Opcodes of the built-in functions.
+typedef enum {
+#define LBUILTIN_OPCODE(name, op, fun, pure) op,
+    LBUILTINS(LBUILTIN_OPCODE)
+#undef LBUILTIN_OPCODE
+    LOP_COUNT
+} LOP;
+
 // A "Lisp value" (lval), which is either "some thing" or an error.
+// Its payload is a (tagged) union, as only the fields for `type` are ever used.
+//
+// Values are reference-counted: since numbers, errors, symbols, strings and functions
+// are never modified, copying them simply shares the same lval. On the other hand,
+// {S,Q}-Expressions each have their own lval, but share (copy-on-write) storage for
+// their cells.
 struct lval {
     LVAL_TYPE   type;
+    int         refs;
+
+    union {
+        // Basic.
+        long        num;
+
+        // Symbol.
+        struct {
+            const char  *sym;  // interned
+            int         slot;  // where it was last bound in its environment (or -1)
+        };
+
+        // String (or error message).
+        struct {
+            union {
+                char    *err; // points to `chars` if it's short, else to the heap
+                char    *str;
+            };
+            int         len;
+            char        chars[LVAL_SHORT_STR_LEN + 1];
+        };
+
+        // Function.
+        struct {
+            lbuiltin    builtin; // NULL for user-defined functions
+            union {
+                LOP     op;      // (built-in functions only)
+                lenv    *env;    // arguments bound by partial application (whose
+                                 // parent is the environment captured by the function)
+            };
+            lval        *formals;
+            lval        *body;
+        };
+
+        // {S,Q}-Expression.
+        struct {
+            int         cell_count;
+            bool        memo;    // if it's the body of a lambda, whether calls to it are
+                                 // memoized (see memo.h)
+            lval        **cell;  // a slice of `store->cell`
+            lcells      *store;  // NULL if there are no cells
+            lcode       *code;   // compiled, if it's the body of a lambda (see vm.h)
+        };
+    };
+};
 
-    // Basic.
-    long        num;
-    char        *err;
-    char        *sym;
-    char        *str;
-
-    // Function.
-    lbuiltin    builtin; // NULL for user-defined functions
-    lenv        *env;
-    lval        *formals;
-    lval        *body;
-
-    // {S,Q}-Expression.
-    int         cell_count;
-    lval        **cell;
+// Storage for the cells of a {S,Q}-Expression, which is shared between its copies
+// until one of them needs to modify it (i.e. copy-on-write). Each copy may only use
+// a slice of it (e.g. `tail` simply skips the first cell). The cells own their lvals.
+// Its capacity grows geometrically, so that appending to it takes amortized O(1).
+struct lcells {
+    int         refs;
+    int         start;    // index of the first owned cell (popping it simply skips it)
+    int         count;    // index past the last owned cell
+    int         capacity;
+    lval        *cell[];
 };
 
+// Number of pointer-sized slots taken by the header of `lcells`.
+#define LCELLS_HEADER ((int)(offsetof(lcells, cell) / sizeof(lval *)))
+
 // A "Lisp environment", which encodes relationships between names and values.
+// Its bindings are kept in (parallel) arrays, in the order they were added, which
+// are also indexed by an open-addressing hash table once there are too many of them
+// to simply be scanned (e.g. in the global environment).
+//
+// Environments are reference-counted, since functions capture the one in which they
+// were defined (i.e. they're closures), which then becomes the parent of the frames
+// in which they're called.
 struct lenv {
-  lenv  *parent_ref; // reference to a parent environment
+  int   refs;
+  lenv  *parent_ref; // (owned) reference to the enclosing environment (NULL if global)
+  lenv  *caller_ref; // reference to the environment from which a frame was called
+  lenv  *global_ref; // reference to the outermost environment (NULL if it's this one)
   int   count;
-  char  **syms;
+  int   capacity;
+  const char **syms; // interned
   lval  **vals;
+  int   *index;      // positions (plus one) in `syms`, by their hash; NULL if unused
+  unsigned index_mask;
 };
 
+// Pools from which every lval and lenv is allocated.
+extern lpool lval_pool;
+extern lpool lenv_pool;
+
+// Stack of the frames in which user-defined functions are called (see `lval_call`),
+// of which there are `lenv_frame_count` (including the ones kept for reuse, i.e. all
+// but the first `lenv_frame_top`).
+extern lenv **lenv_frames;
+extern int lenv_frame_count;
+extern int lenv_frame_top;
+
+// Number of (nested) calls to `lval_eval` (and runs of the virtual machine) currently
+// being evaluated, each of which takes native stack.
+extern int lval_eval_depth;
+
+// Whether only top-level expressions are being evaluated (i.e. those of the files given to
+// clisp, or the input of the REPL), as opposed to those of a file loaded by one of them.
+// Only in between top-level expressions is every value in use reachable from the roots
+// of the collector (see gc.h), since values may otherwise only be referenced from the
+// native stack (e.g. the arguments of a built-in which is loading a file).
+extern bool lval_top_level;
+
+// Limits on the depth of evaluation, past which an error is returned instead (rather than
+// running out of memory or overflowing the native stack): the number of nested evaluations
+// and of calls suspended by the virtual machine or kept by calls in tail position (which
+// is configurable, see `max-depth`), and the number of nested evaluations alone.
+#define LVAL_MAX_DEPTH 1000000
+#define LVAL_MAX_NATIVE_DEPTH 10000
+
+extern int lval_max_depth;
+
+//
+// Immediate numbers.
+//
+
+// Numbers that fit in a pointer (minus one bit) are encoded directly in the `lval *`
+// itself, instead of being allocated. Since any pointer returned by malloc is aligned,
+// its lowest bit is never set, so we use it to tag these "immediate" values.
+// Note that an immediate must never be dereferenced, hence why the type and the value
+// of a (possibly immediate) lval should be read through the functions below.
+#define LVAL_IMM_TAG ((uintptr_t)1)
+#define LVAL_IMM_MIN (INTPTR_MIN / 2)
+#define LVAL_IMM_MAX (INTPTR_MAX / 2)
+
+static inline bool lval_is_imm(const lval *v) {
+    return ((uintptr_t)v & LVAL_IMM_TAG) != 0;
+}
+
+static inline LVAL_TYPE lval_type_of(const lval *v) {
+    return lval_is_imm(v) ? LVAL_NUM : v->type;
+}
+
+static inline long lval_num_of(const lval *v) {
+    // (2n + 1 - 1) / 2 == n, which doesn't rely on the behavior of `>>` for negatives.
+    return lval_is_imm(v) ? (long)((intptr_t)((uintptr_t)v - LVAL_IMM_TAG) / 2) : v->num;
+}
+
 //
 // Constructors (one per LVAL_TYPE).
 //
 
-lval *lval_num(const long num);
+lval *lval_num(const long num); // immediate, unless `num` is out of range
 lval *lval_err(const char *fmt, ...);
 lval *lval_sym(const char *sym);
 lval *lval_str(const char *str);
-lval *lval_fun(lbuiltin fun); // built-in function
+lval *lval_fun(const LOP op); // built-in function
 lval *lval_lambda(lval *formals, lval *body); // user-defined function
 lval *lval_sexpr(void);
 lval *lval_qexpr(void);
@@ -81,6 +285,11 @@ void lenv_free(lenv *e);
 // Helper functions.
 //
 
+// Indicates whether the string (or error message) of `v` is allocated on the heap.
+static inline bool lval_str_is_long(const lval *v) {
+    return v->str != v->chars;
+}
+
 // Returns a string representation of the type.
 char *lval_type_name(LVAL_TYPE t);
 
@@ -91,13 +300,21 @@ lval *lval_add(lval *v, lval *x);
 // then shifts the rest of the list backward and returns the element.
 lval *lval_pop(lval *v, const int i);
 
+// Ensures that a {S,Q}-Expression (`v`) has room for `count` more elements to be added
+// without reallocating (e.g. before adding a known number of elements), and returns it.
+lval *lval_reserve(lval *v, const int count);
+
 // Behaves like `lval_pop`, but the {S,Q}-Expression `v` is deleted.
 lval *lval_take(lval *v, const int i);
 
-// Repeatedly pops items from `y` and adds them to `x`, until `y` is empty.
-// Then deletes `y` and returns `x`.
+// Moves every item of `y` to the end of `x` (copying them only if they're shared),
+// in time linear on the length of `y`. Then deletes `y` and returns `x`.
 lval *lval_join(lval *x, lval *y);
 
+// Indicates whether `v` is the symbol '&' (by pointer, as symbols are interned),
+// which binds the formal after it to the rest of the arguments.
+bool lval_is_rest(const lval *v);
+
 // Calls a (built-in or user-defined) function `f` with arguments `a`.
 // The function is (possibly partially) evaluated on the environment `e`.
 lval *lval_call(lenv *e, lval *f, lval *a);
@@ -105,13 +322,16 @@ lval *lval_call(lenv *e, lval *f, lval *a);
 // Indicates whether `x` is "equal to" `y`.
 bool lval_equals(lval *x, lval *y);
 
-// Creates a copy of an lval.
+// Creates a copy of an lval (which shares whatever it can with `v`, see `struct lval`).
 lval *lval_copy(lval *v);
 
 // Creates a copy of an lenv.
 lenv *lenv_copy(lenv *e);
 
-// Gets the lval mapped by `k`.
+// Gets the lval mapped by `k`, looking it up through the enclosing environments of `e`
+// then, if it isn't found, through those of its callers (e.g. for Q-Expressions that
+// are evaluated by the functions they're passed to, such as `select`).
+// Note that the slot of `k` is tried first, and updated if it's bound in `e` itself.
 lval *lenv_get(lenv *e, lval *k);
 
 // Puts `v`, mapped by `k`, in the local (innermost) environment of `e`.
@@ -120,30 +340,67 @@ void lenv_put(lenv *e, lval *k, lval *v);
 // Puts `v`, mapped by `k`, in the global (outermost) environment of `e`.
 void lenv_def(lenv *e, lval *k, lval *v);
 
+// Pushes a new frame, in which a function will be called, starting with a copy of
+// the bindings of `bindings` (and with the same parent). Frames are reused, so they
+// must be popped in order, but not if a function has captured them.
+lenv *lenv_push_frame(const lenv *bindings);
+void lenv_pop_frame(void);
+
+// Pops the frame below the top one, e.g. the frame of a function which tail-calls
+// another one, in the top frame, that shadows it.
+void lenv_drop_frame(void);
+
+// Indicates whether `e` shadows `x`, i.e. it binds every symbol that `x` binds, and has
+// the same parent. Then nothing can be looked up in `x` (nor in its parents) through `e`.
+bool lenv_shadows(const lenv *e, const lenv *x);
+
 //
 // Built-in functions.
 //
 
-// Adds the built-in functions to environment `e`.
+// Names of the built-in functions, indexed by their opcodes.
+extern const char *const lop_names[LOP_COUNT];
+
+// Built-in functions and whether they're pure, indexed by their opcodes.
+extern const lbuiltin lop_funs[LOP_COUNT];
+extern const bool lop_pure[LOP_COUNT];
+
+// Special forms evaluate their own arguments (only as needed, e.g. a single branch of an
+// `if`) when they're called by name, instead of being called on their values. Otherwise
+// (e.g. through `unpack`), they're called like any other built-in.
+static inline bool lop_is_special(const LOP op) {
+    return op == LOP_IF || op == LOP_AND || op == LOP_OR || op == LOP_DO || op == LOP_LET;
+}
+
+// Adds the built-in functions to environment `e`, except for the list functions.
+// Their names can be rebound like any other (see `lsym_builtin` for when they aren't).
 void lenv_add_builtins(lenv *e);
-void lenv_add_builtin(lenv *e, const char *name, lbuiltin fun);
+
+// Whether the list functions of the prelude are replaced by built-in ones (on by default,
+// see `--no-native-lists`).
+extern bool lval_native_lists;
+
+// Adds the built-in list functions to environment `e` (after the prelude is loaded),
+// unless `lval_native_lists` is false.
+void lenv_add_list_builtins(lenv *e);
+void lenv_add_builtin(lenv *e, const char *name, const LOP op);
 
 // + - * /
-lval *lval_builtin_op(lenv *e, lval *a, const char *op); // (numbers only)
+lval *lval_builtin_op(lenv *e, lval *a, const LOP op); // (numbers only)
 lval *lval_builtin_add(lenv *e, lval *a);
 lval *lval_builtin_sub(lenv *e, lval *a);
 lval *lval_builtin_mul(lenv *e, lval *a);
 lval *lval_builtin_div(lenv *e, lval *a);
 
 // < > <= >=
-lval *lval_builtin_ord(lenv *e, lval *a, const char *op); // (numbers only)
+lval *lval_builtin_ord(lenv *e, lval *a, const LOP op); // (numbers only)
 lval *lval_builtin_lt(lenv *e, lval *a);
 lval *lval_builtin_gt(lenv *e, lval *a);
 lval *lval_builtin_le(lenv *e, lval *a);
 lval *lval_builtin_ge(lenv *e, lval *a);
 
 // == !=
-lval *lval_builtin_cmp(lenv *e, lval *a, const char *op);
+lval *lval_builtin_cmp(lenv *e, lval *a, const LOP op);
 lval *lval_builtin_eq(lenv *e, lval *a);
 lval *lval_builtin_ne(lenv *e, lval *a);
 
@@ -151,6 +408,20 @@ lval *lval_builtin_ne(lenv *e, lval *a);
 // one of the expressions depending on whether or not the condition is true.
 lval *lval_builtin_if(lenv *e, lval *a);
 
+// Return the first of their arguments but the last which is false (for `and`) or true
+// (for `or`), else the last one. Called by name, the rest aren't evaluated.
+lval *lval_builtin_logic(lenv *e, lval *a, const LOP op); // (conditions are numbers)
+lval *lval_logic_type_err(const LOP op, const int index, const lval *cond); // (if they aren't)
+lval *lval_builtin_and(lenv *e, lval *a);
+lval *lval_builtin_or(lenv *e, lval *a);
+
+// Returns its last argument (or `{}`). Called by name, its arguments are evaluated in
+// order, up to the first error.
+lval *lval_builtin_do(lenv *e, lval *a);
+
+// Evaluates a Q-Expression in a new scope (see `lval_eval_scoped`).
+lval *lval_builtin_let(lenv *e, lval *a);
+
 // Takes one or more arguments and returns a new Q-Expression containing the arguments.
 lval *lval_builtin_list(lenv *e, lval *a);
 
@@ -164,13 +435,34 @@ lval *lval_builtin_eval(lenv *e, lval *a);
 lval *lval_builtin_join(lenv *e, lval *a);
 
 // Adds a user-defined variable to the environment `e`.
-lval *lval_builtin_var(lenv *e, lval *a, const char *fun);
+lval *lval_builtin_var(lenv *e, lval *a, const LOP op);
 lval *lval_builtin_def(lenv *e, lval *a); // global assignment
 lval *lval_builtin_put(lenv *e, lval *a); // local assignment
+lval *lval_builtin_const(lenv *e, lval *a); // global constant, which can't be redefined
 
 // Adds a user-defined function to the environment `e`.
+// Its formals are resolved in its body in advance, i.e. each of their symbols is given
+// the slot it will be bound to in the function's environment, once it's called.
 lval *lval_builtin_lambda(lenv *e, lval *a);
 
+// Returns a memoized copy of the user-defined function `a->cell[0]` (see memo.h).
+lval *lval_builtin_memo(lenv *e, lval *a);
+
+// List functions, as defined by the prelude (see `LBUILTINS_LISTS`).
+lval *lval_builtin_len(lenv *e, lval *a);
+lval *lval_builtin_nth(lenv *e, lval *a);
+lval *lval_builtin_last(lenv *e, lval *a);
+lval *lval_builtin_map(lenv *e, lval *a);
+lval *lval_builtin_filter(lenv *e, lval *a);
+lval *lval_builtin_foldl(lenv *e, lval *a);
+lval *lval_builtin_foldr(lenv *e, lval *a);
+lval *lval_builtin_reverse(lenv *e, lval *a);
+lval *lval_builtin_take(lenv *e, lval *a);
+lval *lval_builtin_drop(lenv *e, lval *a);
+lval *lval_builtin_elem(lenv *e, lval *a);
+lval *lval_builtin_zip(lenv *e, lval *a);
+lval *lval_builtin_unzip(lenv *e, lval *a);
+
 // Loads and evaluates a file, given its name in `a->cell[0]->str`.
 lval *lval_builtin_load(lenv *e, lval *a);
 
@@ -181,17 +473,82 @@ lval *lval_builtin_print(lenv *e, lval *a);
 // Returns an LVAL_ERR with the given error message `a->cell[0]->str`.
 lval *lval_builtin_error(lenv *e, lval *a);
 
+// Returns the allocation statistics of the pool named `a->cell[0]->str`
+// (i.e. "lval", "lenv" or "cells"), as a list of `{"name" value}` pairs.
+lval *lval_builtin_pool_stats(lenv *e, lval *a);
+
+// Returns the statistics of the tracing collector, as a list of `{"name" value}` pairs,
+// resetting them if `a->cell[0]->num` is true.
+lval *lval_builtin_gc_stats(lenv *e, lval *a);
+
+// Returns the statistics of the constant folding pass (see fold.h), as a list of
+// `{"name" value}` pairs, resetting them if `a->cell[0]->num` is true.
+lval *lval_builtin_fold_stats(lenv *e, lval *a);
+
+// Sets the number of allocations between collections to `a->cell[0]->num`
+// (where 0 disables the collector, which is the default), and returns the previous one.
+lval *lval_builtin_gc_threshold(lenv *e, lval *a);
+
+// Sets the maximum depth of evaluation to `a->cell[0]->num`, and returns the previous one.
+lval *lval_builtin_max_depth(lenv *e, lval *a);
+
+// Returns the statistics of the memoization cache (see memo.h), as a list of
+// `{"name" value}` pairs, resetting them if `a->cell[0]->num` is true.
+lval *lval_builtin_memo_stats(lenv *e, lval *a);
+
+// Sets the maximum number of memoized results to `a->cell[0]->num` (where 0 disables
+// memoization), and returns the previous one.
+lval *lval_builtin_memo_limit(lenv *e, lval *a);
+
 //
 // Eval.
 //
 
+// Applies an S-Expression whose cells have already been evaluated, i.e. either returns
+// its first error, its only cell, or the result of calling its first cell on the others.
+lval *lval_apply(lenv *e, lval *v);
+
+// Returns an error if evaluating one level deeper would exceed the limits, else NULL.
+lval *lval_check_depth(void);
+
+// Evaluates `v`, without modifying it (nor taking ownership of it): the results of its
+// cells are gathered in separate lists instead. Hence code (e.g. the bodies of functions)
+// can be evaluated any number of times without being copied first.
+lval *lval_eval_code(lenv *e, lval *v);
+
+// Evaluates the cells of the list `code` (whatever its type) as an S-Expression, without
+// modifying it (nor taking ownership of it).
+lval *lval_eval_list(lenv *e, lval *code);
+
+// Likewise, as the body of a function (on frame `e`): if its value is that of a call to a
+// lambda (in tail position), the call isn't made, but returned in `*call` instead (as the
+// evaluated S-Expression, which its caller owns), along with NULL.
+lval *lval_eval_tail(lenv *e, lval *code, lval **call);
+
+// Likewise, but these take ownership of `v`.
 lval *lval_eval_sexpr(lenv *e, lval *v);
 lval *lval_eval(lenv *e, lval *v);
 
+// Evaluates the Q-Expression `body` (without taking ownership of it) as the body of a
+// function called from `e` without arguments, i.e. in a new (and initially empty) frame.
+lval *lval_eval_scoped(lenv *e, lval *body);
+
+// Evaluates each of the top-level expressions `forms` in turn (e.g. those of a loaded
+// file), printing the errors, if any. Takes ownership of `forms`.
+// Garbage is collected in between them, if they're at the top level (see `lval_top_level`).
+void lval_eval_forms(lenv *e, lval *forms);
+
 //
 // Read.
 //
 
+// Creates (and deletes) the parser of the grammar, i.e. `Lispy` and its rules.
+void lval_parser_new(void);
+void lval_parser_delete(void);
+
+// Reads the top-level expressions of a file, into an S-Expression (or an error).
+lval *lval_read_file(const char *path);
+
 lval *lval_read_num(const mpc_ast_t *t);
 lval *lval_read_str(const mpc_ast_t *t);
 lval *lval_read(const mpc_ast_t *t);
@@ -1,43 +1,59 @@
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "ext/mpc.h"
 
+#include "emit.h"
+#include "fold.h"
+#include "gc.h"
 #include "io.h"
 #include "lval.h"
-
-mpc_parser_t *Lispy;
+#include "memo.h"
+#include "vm.h"
 
 int main(int argc, char *argv[]) {
 
-    Lispy                 = mpc_new("lispy");
-    mpc_parser_t *Number  = mpc_new("number");
-    mpc_parser_t *Symbol  = mpc_new("symbol"); // a-z A-Z 0-9 _+-*/\=<>!&
-    mpc_parser_t *String  = mpc_new("string");
-    mpc_parser_t *Comment = mpc_new("comment");
-    mpc_parser_t *Sexpr   = mpc_new("sexpr"); // S(ymbol)-Expression
-    mpc_parser_t *Qexpr   = mpc_new("qexpr"); // Q(uoted)-Expression
-    mpc_parser_t *Expr    = mpc_new("expr");
-
-    #define PARSERS_COUNT 8
-    #define PARSERS_COMMA_SEPARATED \
-        Number, Symbol, String, Comment, Sexpr, Qexpr, Expr, Lispy
-
-    mpca_lang(MPCA_LANG_DEFAULT,
-        "                                                       \
-            number  : /-?[0-9]+/ ;                              \
-            symbol  : /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+/ ;        \
-            string  : /\"(\\\\.|[^\"])*\"/ ;                    \
-            comment : /;[^\\r\\n]*/ ;                           \
-            sexpr   : '(' <expr>* ')' ;                         \
-            qexpr   : '{' <expr>* '}' ;                         \
-            expr    : <number> | <symbol>                       \
-                    | <string> | <comment>                      \
-                    | <sexpr>  | <qexpr> ;                      \
-            lispy   : /^/ <expr>* /$/ ;                         \
-        ",
-        PARSERS_COMMA_SEPARATED
-    );
+    lval_parser_new();
+
+    // Options come before the files to load.
+    bool emit_c = false;
+    int first = 1;
+    for (; first < argc && !strncmp(argv[first], "--", 2); ++first) {
+        if (!strcmp(argv[first], "--emit-c")) {
+            emit_c = true;
+        } else if (!strcmp(argv[first], "--no-fold")) {
+            lfold_enabled = false;
+        } else if (!strcmp(argv[first], "--no-vm")) {
+            lvm_enabled = false;
+        } else if (!strcmp(argv[first], "--no-native-lists")) {
+            lval_native_lists = false;
+        } else if (!strcmp(argv[first], "--memo")) {
+            lmemo_auto = true;
+        } else {
+            fprintf(stderr, "Unknown option '%s'.\n", argv[first]);
+            return 1;
+        }
+    }
+
+    // Translate the files (after the prelude) to C, instead of evaluating them.
+    if (emit_c) {
+        if (first == argc) {
+            fputs("Option '--emit-c' expects files to translate.\n", stderr);
+            return 1;
+        }
+
+        // (The program name is replaced by the prelude's.)
+        argv[first - 1] = "prelude.cl";
+        lval *x = lemit_program(stdout, argv + first - 1, argc - first + 1);
+
+        const bool failed = lval_type_of(x) == LVAL_ERR;
+        if (failed) fprintf(stderr, "Error: %s\n", x->err);
+        lval_free(x);
+
+        lval_parser_delete();
+        return failed;
+    }
 
     // Create an environment with built-in functions.
     lenv *e = lenv_new();
@@ -45,17 +61,20 @@ int main(int argc, char *argv[]) {
 
     // Load the standard library functions.
     lval *std = lval_builtin_load(e, lval_add(lval_sexpr(), lval_str("prelude.cl")));
-    if (std->type == LVAL_ERR) lval_println(std);
+    if (lval_type_of(std) == LVAL_ERR) lval_println(std);
     lval_free(std);
 
-    if (argc >= 2) {
-        for (int i = 1; i < argc; ++i) {
+    // Replace its list functions by built-in ones.
+    lenv_add_list_builtins(e);
+
+    if (first < argc) {
+        for (int i = first; i < argc; ++i) {
             // Create an argument list with a single argument
             // (the filename), then load and evaluate its contents.
             lval *args = lval_add(lval_sexpr(), lval_str(argv[i]));
             lval *x = lval_builtin_load(e, args);
 
-            if (x->type == LVAL_ERR) lval_println(x);
+            if (lval_type_of(x) == LVAL_ERR) lval_println(x);
             lval_free(x);
         }
     } else {
@@ -70,11 +89,16 @@ int main(int argc, char *argv[]) {
             // Parse the user input.
             mpc_result_t r;
             if (mpc_parse("<stdin>", input, Lispy, &r)) {
+                lval_top_level = false;
                 lval *x = lval_eval(e, lval_read(r.output));
+                lval_top_level = true;
                 lval_println(x);
 
                 lval_free(x);
                 mpc_ast_delete(r.output);
+
+                // Nothing else is in use in between inputs, so it's a safe point.
+                lgc_maybe_collect(e, NULL, 0);
             } else {
                 mpc_err_print(r.error);
                 mpc_err_delete(r.error);
@@ -84,10 +108,10 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    lmemo_clear();
     lenv_free(e);
 
-    // Undefine and delete parsers.
-    mpc_cleanup(PARSERS_COUNT, PARSERS_COMMA_SEPARATED);
+    lval_parser_delete();
 
     return 0;
 }
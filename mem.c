@@ -0,0 +1,176 @@
+#include "mem.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Slabs.
+//
+
+// Slabs are aligned to their size, so that the slab of an object can be found by
+// masking its address. The mark bits of its objects are kept in the slab header.
+#define SLAB_SIZE        ((size_t)1 << 15)
+#define SLAB_MAX_OBJECTS (SLAB_SIZE / sizeof(void *))
+
+// Slabs are allocated in batches (since aligning each one would waste as much memory).
+#define SLABS_PER_BATCH 32
+
+typedef struct lslab {
+    struct lslab    *next;
+    size_t          size;  // of each object
+    size_t          count; // of objects
+    char            *objects;
+    unsigned char   mark[SLAB_MAX_OBJECTS / 8];
+} lslab;
+
+// Slabs that have been allocated, but not yet handed out to a pool.
+static lslab *spare_slabs = NULL;
+
+static lslab *lslab_new(void) {
+    if (!spare_slabs) {
+        char *batch = malloc((SLABS_PER_BATCH + 1) * SLAB_SIZE);
+        char *aligned = (char *)(((uintptr_t)batch + SLAB_SIZE - 1) & ~(uintptr_t)(SLAB_SIZE - 1));
+
+        for (int i = SLABS_PER_BATCH - 1; i >= 0; --i) {
+            lslab *slab = (lslab *)(aligned + i * SLAB_SIZE);
+            slab->next = spare_slabs;
+            spare_slabs = slab;
+        }
+    }
+
+    lslab *slab = spare_slabs;
+    spare_slabs = slab->next;
+    return slab;
+}
+
+static lslab *lslab_of(const void *x) {
+    return (lslab *)((uintptr_t)x & ~(uintptr_t)(SLAB_SIZE - 1));
+}
+
+//
+// Pools.
+//
+
+static void lpool_grow(lpool *p) {
+    lslab *slab = lslab_new();
+    slab->next = p->slabs;
+    slab->size = p->size;
+
+    // Objects start after the header, aligned to 16 bytes.
+    const size_t header = (sizeof(lslab) + 15) & ~(size_t)15;
+    slab->objects = (char *)slab + header;
+    slab->count = (SLAB_SIZE - header) / p->size;
+
+    p->slabs = slab;
+    p->slab_count++;
+
+    // Thread every object of the new slab into the free list.
+    for (size_t i = slab->count; i-- > 0;) {
+        void *x = slab->objects + i * p->size;
+        *(void **)x = p->free_list;
+        p->free_list = x;
+    }
+}
+
+void *lpool_alloc(lpool *p) {
+    p->allocs++;
+
+    if (p->free_list) p->hits++;
+    else              lpool_grow(p);
+
+    void *x = p->free_list;
+    p->free_list = *(void **)x;
+
+    p->live++;
+    return x;
+}
+
+void lpool_free(lpool *p, void *x) {
+    *(void **)x = p->free_list;
+    p->free_list = x;
+
+    p->live--;
+}
+
+bool lpool_mark(void *x) {
+    lslab *slab = lslab_of(x);
+    const size_t i = ((char *)x - slab->objects) / slab->size;
+
+    if (slab->mark[i / 8] & (1 << (i % 8))) return false;
+    slab->mark[i / 8] |= 1 << (i % 8);
+    return true;
+}
+
+bool lpool_is_marked(const void *x) {
+    const lslab *slab = lslab_of(x);
+    const size_t i = ((const char *)x - slab->objects) / slab->size;
+
+    return (slab->mark[i / 8] & (1 << (i % 8))) != 0;
+}
+
+void lpool_clear_marks(lpool *p) {
+    for (lslab *slab = p->slabs; slab; slab = slab->next)
+        memset(slab->mark, 0, sizeof(slab->mark));
+}
+
+void lpool_mark_free(lpool *p) {
+    for (void *x = p->free_list; x; x = *(void **)x)
+        lpool_mark(x);
+}
+
+void lpool_each_unmarked(lpool *p, void (*fn)(void *x, void *ctx), void *ctx) {
+    for (lslab *slab = p->slabs; slab; slab = slab->next)
+        for (size_t i = 0; i < slab->count; ++i)
+            if (!(slab->mark[i / 8] & (1 << (i % 8))))
+                fn(slab->objects + i * slab->size, ctx);
+}
+
+//
+// Cell arrays.
+//
+
+lpool lcells_pools[LCELLS_CLASSES] = {
+    { 1 * sizeof(void *) }, { 2 * sizeof(void *) }, { 4 * sizeof(void *) },
+    { 8 * sizeof(void *) }, { 16 * sizeof(void *) },
+};
+
+unsigned long lcells_large_allocs = 0;
+
+// Returns the index of the smallest size class that fits `count` pointers,
+// or LCELLS_CLASSES if it should be allocated with malloc instead.
+static int lcells_class(const int count) {
+    int class = 0;
+    while (class < LCELLS_CLASSES && (1 << class) < count) class++;
+    return class;
+}
+
+void *lcells_resize(void *cells, const int old_count, const int new_count) {
+    const int old_class = old_count ? lcells_class(old_count) : -1;
+    const int new_class = new_count ? lcells_class(new_count) : -1;
+
+    // Still fits in the same pooled slot (or is empty in both cases).
+    if (old_class == new_class && new_class < LCELLS_CLASSES) return cells;
+
+    // Both are too large to be pooled.
+    if (old_class == LCELLS_CLASSES && new_class == LCELLS_CLASSES)
+        return realloc(cells, new_count * sizeof(void *));
+
+    void *resized = NULL;
+    if (new_class == LCELLS_CLASSES) {
+        lcells_large_allocs++;
+        resized = malloc(new_count * sizeof(void *));
+    } else if (new_class >= 0) {
+        resized = lpool_alloc(&lcells_pools[new_class]);
+    }
+
+    if (cells) {
+        const int kept = old_count < new_count ? old_count : new_count;
+        if (resized) memcpy(resized, cells, kept * sizeof(void *));
+
+        if (old_class == LCELLS_CLASSES) free(cells);
+        else                             lpool_free(&lcells_pools[old_class], cells);
+    }
+
+    return resized;
+}
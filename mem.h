@@ -0,0 +1,58 @@
+#ifndef __CLISP_MEM_H__
+#define __CLISP_MEM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A pool of same-size objects, carved out of larger slabs and recycled through a free
+// list, so that (once warmed up) allocating and freeing never reach the system allocator.
+// Note that slabs are never given back, as the interpreter keeps churning the same objects.
+typedef struct lpool {
+    size_t          size;      // size of each object, in bytes
+    void            *free_list; // free objects, linked through their first word
+    struct lslab    *slabs;     // allocated slabs
+
+    // Statistics.
+    unsigned long   allocs;    // total number of allocations
+    unsigned long   hits;      // allocations served directly by the free list
+    unsigned long   live;      // objects currently in use
+    unsigned long   slab_count;
+} lpool;
+
+// Initializer for a pool of objects of type `T`.
+#define LPOOL(T) { sizeof(T) > sizeof(void *) ? sizeof(T) : sizeof(void *) }
+
+void *lpool_alloc(lpool *p);
+void lpool_free(lpool *p, void *x);
+
+// Each object also has a mark bit (kept in its slab), for the tracing collector.
+// Note that these must only be called on objects allocated from a pool.
+bool lpool_mark(void *x); // returns false if `x` was already marked
+bool lpool_is_marked(const void *x);
+
+// Clears the mark bit of every object in `p`.
+void lpool_clear_marks(lpool *p);
+
+// Sets the mark bit of every free object in `p` (so that only unmarked objects are in use).
+void lpool_mark_free(lpool *p);
+
+// Calls `fn` on every unmarked object in `p`.
+void lpool_each_unmarked(lpool *p, void (*fn)(void *x, void *ctx), void *ctx);
+
+//
+// Cell arrays.
+//
+
+// Arrays of up to LCELLS_POOLED_MAX pointers come from pools, by power-of-two size
+// classes (i.e. for 1, 2, 4, 8 and 16 pointers), while larger ones use malloc.
+#define LCELLS_CLASSES    5
+#define LCELLS_POOLED_MAX (1 << (LCELLS_CLASSES - 1))
+
+extern lpool lcells_pools[LCELLS_CLASSES];
+extern unsigned long lcells_large_allocs; // arrays larger than LCELLS_POOLED_MAX
+
+// Resizes an array of `old_count` pointers to hold `new_count` pointers (keeping the
+// first ones), behaving like `realloc`. A count of zero is represented by NULL.
+void *lcells_resize(void *cells, const int old_count, const int new_count);
+
+#endif // __CLISP_MEM_H__
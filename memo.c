@@ -0,0 +1,264 @@
+#include "memo.h"
+#include "sym.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+lmemo_stats lmemo = { .capacity = LMEMO_CAPACITY };
+bool lmemo_auto = false;
+
+//
+// Purity.
+//
+
+// Returns whether `k` names a built-in function (as it's bound when the lambda is
+// created, which isn't shadowed by one of its formals), and its opcode.
+static bool lmemo_builtin_of(const lval *formals, const lval *k, LOP *op) {
+    if (lval_type_of(k) != LVAL_SYM) return false;
+    for (int i = 0; i < formals->cell_count; ++i)
+        if (formals->cell[i]->sym == k->sym) return false;
+
+    const int builtin = lsym_builtin(k->sym);
+    if (builtin >= 0) *op = builtin;
+    return builtin >= 0;
+}
+
+static bool lmemo_is_pure_list(const lval *formals, const lval *v);
+
+static bool lmemo_is_pure_expr(const lval *formals, const lval *v) {
+    switch (lval_type_of(v)) {
+        case LVAL_SYM:
+            if (lsym_is_const(v->sym)) return true;
+            for (int i = 0; i < formals->cell_count; ++i)
+                if (formals->cell[i]->sym == v->sym) return true;
+            return false;
+
+        case LVAL_SEXPR:
+            return lmemo_is_pure_list(formals, v);
+
+        default:
+            // Q-Expressions are data (unless they're the branches of an `if`).
+            return true;
+    }
+}
+
+// Whether evaluating a branch of an `if` is pure, knowing that only literal ones are (since
+// `if` evaluates the value of any other one in turn).
+static bool lmemo_is_pure_branch(const lval *formals, const lval *v) {
+    return lval_type_of(v) == LVAL_QEXPR && lmemo_is_pure_list(formals, v);
+}
+
+// Whether evaluating the cells of `v` as an S-Expression is pure.
+static bool lmemo_is_pure_list(const lval *formals, const lval *v) {
+    if (v->cell_count == 0) return true;
+    if (v->cell_count == 1) return lmemo_is_pure_expr(formals, v->cell[0]);
+
+    LOP op;
+    if (!lmemo_builtin_of(formals, v->cell[0], &op)) return false;
+
+    if (op == LOP_IF) {
+        return v->cell_count == 4
+            && lmemo_is_pure_expr(formals, v->cell[1])
+            && lmemo_is_pure_branch(formals, v->cell[2])
+            && lmemo_is_pure_branch(formals, v->cell[3]);
+    }
+    if (!lop_pure[op]) return false;
+
+    for (int i = 1; i < v->cell_count; ++i)
+        if (!lmemo_is_pure_expr(formals, v->cell[i])) return false;
+    return true;
+}
+
+bool lmemo_is_pure(const lval *formals, const lval *body) {
+    return lmemo_is_pure_list(formals, body);
+}
+
+//
+// Cache.
+//
+
+// A memoized call, which is both in a bucket of the hash table, and in the list of every
+// entry from the most recently used to the least recently used one.
+typedef struct lmemo_entry {
+    unsigned            hash;
+    lval                *fun;
+    lval                *args;   // S-Expression
+    lval                *result;
+
+    struct lmemo_entry  *next;   // in its bucket
+    struct lmemo_entry  *newer;
+    struct lmemo_entry  *older;
+} lmemo_entry;
+
+static lmemo_entry **buckets = NULL;
+static unsigned bucket_mask = 0; // (number of buckets, minus one)
+static lmemo_entry *newest = NULL;
+static lmemo_entry *oldest = NULL;
+
+// FNV-1a, one word at a time (folding both halves of `x`, if it's wider than `h`).
+static inline unsigned lmemo_mix(const unsigned h, const unsigned long x) {
+    return (h ^ (unsigned)x ^ (unsigned)(x >> 16 >> 16)) * 16777619u;
+}
+
+static unsigned lmemo_hash_bytes(unsigned h, const char *s, const int len) {
+    for (int i = 0; i < len; ++i) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+// Hashes `v` such that values which are `lval_equals` have the same hash.
+static unsigned lmemo_hash(unsigned h, const lval *v) {
+    const LVAL_TYPE type = lval_type_of(v);
+    h = lmemo_mix(h, type);
+
+    switch (type) {
+        case LVAL_NUM: return lmemo_mix(h, (unsigned long)lval_num_of(v));
+        case LVAL_ERR: return lmemo_hash_bytes(h, v->err, v->len);
+        case LVAL_SYM: return lmemo_mix(h, lsym_hash(v->sym));
+        case LVAL_STR: return lmemo_hash_bytes(h, v->str, v->len);
+
+        case LVAL_FUN:
+            if (v->builtin) return lmemo_mix(h, v->op);
+            return lmemo_hash(lmemo_hash(h, v->formals), v->body);
+
+        case LVAL_SEXPR:
+        case LVAL_QEXPR:
+            h = lmemo_mix(h, v->cell_count);
+            for (int i = 0; i < v->cell_count; ++i) h = lmemo_hash(h, v->cell[i]);
+            return h;
+    }
+    return h;
+}
+
+// Like `lval_equals`, except that lambdas are only equal to themselves.
+static bool lmemo_equals(lval *x, lval *y) {
+    if (lval_type_of(x) == LVAL_FUN && lval_type_of(y) == LVAL_FUN)
+        return x->builtin ? x->builtin == y->builtin : x == y;
+
+    if (lval_type_of(x) != LVAL_SEXPR && lval_type_of(x) != LVAL_QEXPR)
+        return lval_equals(x, y);
+
+    if (lval_type_of(x) != lval_type_of(y) || x->cell_count != y->cell_count) return false;
+    for (int i = 0; i < x->cell_count; ++i)
+        if (!lmemo_equals(x->cell[i], y->cell[i])) return false;
+    return true;
+}
+
+static void lmemo_unlink(lmemo_entry *entry) {
+    if (entry->newer) entry->newer->older = entry->older; else newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer; else oldest = entry->newer;
+}
+
+static void lmemo_link_newest(lmemo_entry *entry) {
+    entry->newer = NULL;
+    entry->older = newest;
+    if (newest) newest->newer = entry; else oldest = entry;
+    newest = entry;
+}
+
+static void lmemo_evict_oldest(void) {
+    lmemo_entry *entry = oldest;
+    lmemo_unlink(entry);
+
+    lmemo_entry **link = &buckets[entry->hash & bucket_mask];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+
+    lval_free(entry->fun);
+    lval_free(entry->args);
+    lval_free(entry->result);
+    free(entry);
+
+    lmemo.entries--;
+    lmemo.evictions++;
+}
+
+// Doubles the number of buckets (or allocates the first ones).
+static void lmemo_grow(void) {
+    const unsigned count = buckets ? 2 * (bucket_mask + 1) : 256;
+    lmemo_entry **old = buckets;
+    const unsigned old_count = buckets ? bucket_mask + 1 : 0;
+
+    buckets = calloc(count, sizeof(lmemo_entry *));
+    bucket_mask = count - 1;
+
+    for (unsigned i = 0; i < old_count; ++i) {
+        for (lmemo_entry *entry = old[i], *next; entry; entry = next) {
+            next = entry->next;
+            entry->next = buckets[entry->hash & bucket_mask];
+            buckets[entry->hash & bucket_mask] = entry;
+        }
+    }
+    free(old);
+}
+
+static lmemo_entry *lmemo_find(lval *f, lval *a, const unsigned hash) {
+    if (!buckets) return NULL;
+
+    for (lmemo_entry *entry = buckets[hash & bucket_mask]; entry; entry = entry->next) {
+        if (entry->hash == hash && entry->fun == f && lmemo_equals(entry->args, a))
+            return entry;
+    }
+    return NULL;
+}
+
+lval *lmemo_get(lval *f, lval *a, unsigned *hash) {
+    *hash = lmemo_hash(lmemo_mix(2166136261u, (unsigned long)(uintptr_t)f), a);
+
+    lmemo_entry *entry = lmemo_find(f, a, *hash);
+    if (!entry) {
+        lmemo.misses++;
+        return NULL;
+    }
+
+    lmemo_unlink(entry);
+    lmemo_link_newest(entry);
+
+    lmemo.hits++;
+    return lval_copy(entry->result);
+}
+
+void lmemo_put(lval *f, lval *a, const unsigned hash, lval *result) {
+    // (The same call may also have been memoized while it was evaluated, e.g. by recursion.)
+    if (!lmemo.capacity || lval_type_of(result) == LVAL_ERR || lmemo_find(f, a, hash)) {
+        lval_free(a);
+        return;
+    }
+
+    if (lmemo.entries == lmemo.capacity) lmemo_evict_oldest();
+    if (!buckets || lmemo.entries > bucket_mask) lmemo_grow();
+
+    lmemo_entry *entry = malloc(sizeof(lmemo_entry));
+    entry->hash = hash;
+    entry->fun = lval_copy(f);
+    entry->args = a;
+    entry->result = lval_copy(result);
+
+    entry->next = buckets[hash & bucket_mask];
+    buckets[hash & bucket_mask] = entry;
+    lmemo_link_newest(entry);
+
+    lmemo.entries++;
+}
+
+void lmemo_set_capacity(const unsigned long capacity) {
+    lmemo.capacity = capacity;
+    while (lmemo.entries > capacity) lmemo_evict_oldest();
+}
+
+void lmemo_each(void (*fn)(lval *v)) {
+    for (lmemo_entry *entry = newest; entry; entry = entry->older) {
+        fn(entry->fun);
+        fn(entry->args);
+        fn(entry->result);
+    }
+}
+
+void lmemo_clear(void) {
+    const unsigned long evictions = lmemo.evictions;
+    while (lmemo.entries) lmemo_evict_oldest();
+    lmemo.evictions = evictions;
+
+    free(buckets);
+    buckets = NULL;
+    bucket_mask = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef __CLISP_MEMO_H__
+#define __CLISP_MEMO_H__
+
+#include "lval.h"
+
+// Memoization of calls to user-defined functions, i.e. a cache of their results keyed by
+// the function and its arguments, so that calling a pure function again with the same
+// arguments simply returns (a copy of) the same result.
+//
+// Functions are memoized explicitly with `memo` (which trusts them to be pure), or when
+// they're created, if `--memo` is given and their body can't call anything but pure
+// built-ins (see `lmemo_is_pure`). Their body is marked as such, so calls to them (even
+// partial applications) go through `lval_call` rather than being run in place by the
+// virtual machine. Their errors and partial applications are never memoized.
+//
+// Arguments are hashed structurally, as `lval_equals` compares them (except for lambdas,
+// which only match themselves, since they may have bound different arguments). Up to
+// `lmemo.capacity` results are kept, evicting the least recently used one first.
+
+typedef struct lmemo_stats {
+    unsigned long capacity; // max number of results kept (0 disables the cache)
+    unsigned long entries;  // number of results currently kept
+
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+} lmemo_stats;
+
+extern lmemo_stats lmemo;
+
+// Default number of results kept.
+#define LMEMO_CAPACITY 4096
+
+// Whether pure lambdas are memoized when they're created (off by default, see `--memo`).
+extern bool lmemo_auto;
+
+// Indicates whether a lambda can only call pure built-ins (including `if`, whose branches
+// are then checked as code) and only refers to its formals and to constants, so that its
+// result only depends on its arguments (as long as the names of those built-ins resolve
+// to them, see `lsym_builtins_resolved`, which calls are only memoized while they all do).
+bool lmemo_is_pure(const lval *formals, const lval *body);
+
+// Returns (a copy of) the memoized result of calling `f` on `a`, or NULL if there is none.
+// In either case, sets `hash` to that of the call (for `lmemo_put`).
+lval *lmemo_get(lval *f, lval *a, unsigned *hash);
+
+// Memoizes (a copy of) `result`, unless it's an error, as that of calling `f` on `a`.
+// Takes ownership of `a`.
+void lmemo_put(lval *f, lval *a, const unsigned hash, lval *result);
+
+// Evicts results until at most `capacity` are kept, and keeps at most that many from now on.
+void lmemo_set_capacity(const unsigned long capacity);
+
+// Calls `fn` on every value kept by the cache (e.g. to mark them as reachable).
+void lmemo_each(void (*fn)(lval *v));
+
+// Evicts every result.
+void lmemo_clear(void);
+
+#endif // __CLISP_MEMO_H__
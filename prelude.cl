@@ -8,9 +8,9 @@
 ;;; Atoms
 ;;;
 
-(def {nil} {})
-(def {true} 1)
-(def {false} 0)
+(const {nil} {})
+(const {true} 1)
+(const {false} 0)
 
 ;;;
 ;;; Functional functions
@@ -20,9 +20,7 @@
 (def {fun} (\ {args body} {
     def (head args) (\ (tail args) body)}))
 
-; Open new scope
-(fun {let body} {
-    ((\ {_} body) ())})
+; (`let`, which opens a new scope, is built in.)
 
 ; Unpack list to function
 (fun {unpack f lst} {
@@ -35,19 +33,14 @@
 (def {curry} unpack)
 (def {uncurry} pack)
 
-; Perform several things in sequence
-(fun {do & lst} {
-    if (== lst nil)
-        {nil}
-        {last lst}})
+; (`do`, which performs several things in sequence, is built in.)
 
 ;;;
 ;;; Logical functions
 ;;;
 
-(fun {not x}   {- 1 x})
-(fun {or  x y} {+ x y})
-(fun {and x y} {* x y})
+; (`and` and `or`, which only evaluate their arguments as needed, are built in.)
+(fun {not x} {- 1 x})
 
 ;;;
 ;;; Miscelaneous functions
@@ -108,12 +101,15 @@
             {snd (fst cs)}
             {unpack case (join (list x) (tail cs))}}})
 
-(def {otherwise} true)
+(const {otherwise} true)
 
 ;;;
 ;;; List functions
 ;;;
 
+; (Most of these are replaced by built-in ones once the prelude is loaded,
+; unless `--no-native-lists` is given.)
+
 ; First, second, and third item in list
 (fun {fst lst} {eval (head lst)})
 (fun {snd lst} {eval (head (tail lst))})
@@ -160,7 +156,7 @@
         {join (head lst) (init (tail lst))}})
 
 ; Reverse list
-(fun {reverse l} {
+(fun {reverse lst} {
     if (== lst nil)
         {nil}
         {join (reverse (tail lst)) (head lst)}})
@@ -0,0 +1,132 @@
+#include "sym.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// An interned symbol, whose name is stored inline after its hash.
+typedef struct lsym {
+    unsigned    hash;
+    int         bindings;
+    bool        constant;
+    int         builtin;  // opcode of the built-in function it names, or -1
+    bool        rebound;  // (if its global value has since been replaced)
+    char        name[];
+} lsym;
+
+// Open-addressing (linear probing) hash table of interned symbols.
+static lsym **table = NULL;
+static unsigned capacity = 0; // always a power of two
+static unsigned count = 0;
+
+// Number of bindings of the names of built-in functions other than to those (i.e. beyond
+// their global one, or replacing it).
+static int unresolved = 0;
+
+// FNV-1a.
+static unsigned lsym_hash_str(const char *name) {
+    unsigned h = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c; ++c)
+        h = (h ^ *c) * 16777619u;
+    return h;
+}
+
+static void lsym_insert(lsym *s) {
+    unsigned i = s->hash & (capacity - 1);
+    while (table[i]) i = (i + 1) & (capacity - 1);
+    table[i] = s;
+}
+
+static void lsym_grow(void) {
+    lsym **old_table = table;
+    const unsigned old_capacity = capacity;
+
+    capacity = capacity ? 2 * capacity : 256;
+    table = calloc(capacity, sizeof(lsym *));
+
+    for (unsigned i = 0; i < old_capacity; ++i)
+        if (old_table[i]) lsym_insert(old_table[i]);
+
+    free(old_table);
+}
+
+const char *lsym_intern(const char *name) {
+    const unsigned hash = lsym_hash_str(name);
+
+    if (capacity) {
+        for (unsigned i = hash & (capacity - 1); table[i]; i = (i + 1) & (capacity - 1))
+            if (table[i]->hash == hash && !strcmp(table[i]->name, name))
+                return table[i]->name;
+    }
+
+    // Keep the load factor under 2/3.
+    if (3 * (count + 1) > 2 * capacity) lsym_grow();
+
+    lsym *s = malloc(sizeof(lsym) + strlen(name) + 1);
+    s->hash = hash;
+    s->bindings = 0;
+    s->constant = false;
+    s->builtin = -1;
+    s->rebound = false;
+    strcpy(s->name, name);
+
+    lsym_insert(s);
+    count++;
+
+    return s->name;
+}
+
+// Returns the interned symbol whose name is `sym`.
+static lsym *lsym_of(const char *sym) {
+    return (lsym *)(sym - offsetof(lsym, name));
+}
+
+unsigned lsym_hash(const char *sym) {
+    return lsym_of(sym)->hash;
+}
+
+void lsym_bind(const char *sym) {
+    lsym *s = lsym_of(sym);
+    if (++s->bindings > 1 && s->builtin >= 0) unresolved++;
+}
+
+void lsym_unbind(const char *sym) {
+    lsym *s = lsym_of(sym);
+    if (s->bindings-- > 1 && s->builtin >= 0) unresolved--;
+}
+
+int lsym_bindings(const char *sym) {
+    return lsym_of(sym)->bindings;
+}
+
+void lsym_set_const(const char *sym) {
+    lsym_of(sym)->constant = true;
+}
+
+bool lsym_is_const(const char *sym) {
+    return lsym_of(sym)->constant;
+}
+
+void lsym_set_builtin(const char *sym, const int op) {
+    lsym *s = lsym_of(sym);
+    if (s->rebound) unresolved--;
+    s->builtin = op;
+    s->rebound = false;
+}
+
+void lsym_rebind(const char *sym) {
+    lsym *s = lsym_of(sym);
+    if (s->builtin < 0 || s->rebound) return;
+    s->rebound = true;
+    unresolved++;
+}
+
+int lsym_builtin(const char *sym) {
+    const lsym *s = lsym_of(sym);
+    return s->bindings == 1 && !s->rebound ? s->builtin : -1;
+}
+
+bool lsym_builtins_resolved(void) {
+    return unresolved == 0;
+}
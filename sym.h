@@ -0,0 +1,42 @@
+#ifndef __CLISP_SYM_H__
+#define __CLISP_SYM_H__
+
+#include <stdbool.h>
+
+// Symbols are interned in a process-wide table, so that there's a single (canonical)
+// copy of each name. Hence, two interned symbols are equal iff their pointers are,
+// and they can be shared freely since they're never deallocated.
+
+// Returns the canonical copy of `name`, interning it if it wasn't yet.
+const char *lsym_intern(const char *name);
+
+// Returns the hash of an interned symbol (computed once, when it was interned).
+unsigned lsym_hash(const char *sym);
+
+// Counts the environments in which an interned symbol is currently bound, so that
+// looking it up can tell whether it might be shadowed (see `lenv_get`).
+void lsym_bind(const char *sym);
+void lsym_unbind(const char *sym);
+int lsym_bindings(const char *sym);
+
+// Marks an interned symbol as a (global) constant, which can't be bound ever again.
+void lsym_set_const(const char *sym);
+bool lsym_is_const(const char *sym);
+
+// Records that an interned symbol names the built-in function whose opcode is `op`, i.e.
+// that its global value is that built-in.
+void lsym_set_builtin(const char *sym, const int op);
+
+// Records that the global value of an interned symbol has been replaced, so that if it
+// named a built-in function, it no longer does.
+void lsym_rebind(const char *sym);
+
+// Returns the opcode of the built-in function an interned symbol names, as long as that's
+// its only binding (i.e. wherever it's looked up, it resolves to that built-in).
+// Otherwise (e.g. while it's the formal of a function being called), returns -1.
+int lsym_builtin(const char *sym);
+
+// Whether the names of all built-in functions currently resolve to them (as above).
+bool lsym_builtins_resolved(void);
+
+#endif // __CLISP_SYM_H__
@@ -0,0 +1,23 @@
+; The names of built-in functions can be bound like any other (only those defined with
+; `const`, e.g. `nil`, can't).
+(fun {first list} {head list})
+(print (first {1 2 3}))
+(fun {apply-to + x} {+ x x})
+(print (apply-to (\ {a b} {list a b}) 5))
+(print (fun {f nil} {nil}))
+
+; Formals shadow them in whatever their function calls, special forms included.
+(fun {add a b} {+ a b})
+(fun {with-plus +} {add 3 4})
+(print (with-plus *) (add 3 4))
+(fun {pick c} {if c {1} {2}})
+(fun {with-if if} {pick 0})
+(print (with-if (\ {c a b} {c})) (pick 0))
+
+; Calls are folded only as long as their name refers to the built-in.
+(fun {three _} {+ 1 2})
+(fun {known x} {if (== 1 1) {x} {0}})
+(print (three ()) (known 5))
+(def {+} -)
+(def {==} !=)
+(print (three ()) (known 5))
@@ -0,0 +1,21 @@
+; Closures capture the frame in which they're created, even once it has been popped.
+(fun {adder n} {\ {x} {+ x n}})
+(def {add5} (adder 5))
+(print (add5 1) ((adder 10) 1))
+(print (map (adder 2) {1 2 3}))
+
+; A closure bound in the frame it captures forms a cycle, which is released along with it.
+(fun {live-envs _} {nth 2 (pool-stats "lenv")})
+(fun {mk n} {do (= {f} (\ {x} {+ x n})) f})
+(fun {mk-call n} {do (= {f} (\ {x} {+ x n})) (f 1)})
+(fun {rep g n} {if (== n 0) {0} {do (g n) (rep g (- n 1))}})
+
+; (Frames are kept for reuse, so the first calls may leave some more.)
+(rep mk-call 1000)
+(def {before} (live-envs ()))
+(rep mk 1000)
+(rep mk-call 1000)
+(print (== before (live-envs ())))
+
+(def {kept} (mk 7))
+(print (kept 1))
@@ -0,0 +1,7 @@
+; Loaded by other tests (with a few top-level expressions, in between which garbage may be
+; collected).
+(def {loaded-x} {1 2 3})
+(fun {loaded-f x} {list x x})
+(def {loaded-y} (loaded-f loaded-x))
+(def {loaded-z} (join loaded-x loaded-x))
+(def {loaded-n} (len loaded-z))
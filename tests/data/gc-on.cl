@@ -0,0 +1,2 @@
+; Loaded before a test by tests/run.sh, so that the collector collects whenever it can.
+(gc-threshold 1)
@@ -0,0 +1,3 @@
+; Loaded by tests/gc.cl, loading another file in turn.
+(load "tests/data/defs.cl")
+(def {nested-y} (join loaded-y loaded-y))
@@ -0,0 +1,8 @@
+; The built-in list functions may apply `load`, which must not collect what they're still
+; working on (their arguments and result so far) while it's evaluating the file. (Their
+; calls are top-level expressions, so as not to be nested in another evaluation.)
+(gc-threshold 1)
+(map load {"tests/data/defs.cl"})
+(map load {"tests/data/defs.cl" "tests/data/defs.cl"})
+(foldl (\ {_ f} {load f}) () {"tests/data/defs.cl" "tests/data/defs.cl"})
+(print loaded-y loaded-n)
@@ -0,0 +1,24 @@
+; The collector (see gc.h), collecting whenever it can.
+(gc-threshold 1)
+
+; Code passed to `eval` is only referenced from the native stack while it's evaluated, so a
+; file it loads mustn't collect it.
+(eval {load "tests/data/defs.cl"})
+(eval {eval {load "tests/data/defs.cl"}})
+(print loaded-y loaded-n)
+
+; Likewise, the expression which loads a file may still be using values, so neither that
+; file nor the ones it loads in turn collect in between their own expressions.
+(gc-stats true)
+(load "tests/data/nested.cl")
+(print nested-y)
+
+; Garbage is collected in between top-level expressions (once after each of them here, the
+; `gc-stats` which resets the count included), as they allocate more than the threshold.
+(fun {gc-stat k} {snd (fst (filter (\ {s} {== (fst s) k}) (gc-stats false)))})
+(print (gc-stat "threshold") (gc-stat "collections"))
+(gc-stats true)
+(def {garbage} (map (\ {x} {list x x}) {1 2 3}))
+(def {garbage} ())
+(print (gc-stat "collections"))
+(print (gc-threshold 0) (gc-stat "threshold"))
@@ -0,0 +1,11 @@
+; The branches of an `if` are evaluated as they're written when they're literal
+; Q-Expressions. Otherwise, the Q-Expression each one evaluates to is evaluated in turn.
+(def {t} {+ 1 2})
+(print (if 1 t {0}) (if 0 {0} t))
+(fun {choose c a b} {if c a b})
+(print (choose 1 {+ 10 1} {0}) (choose 0 {0} {* 2 3}))
+(fun {choose-last c a b} {do (+ 1 1) (if c a b)})
+(print (choose-last 1 {+ 10 1} {0}))
+(print (if 1 {+ 1 2} {0}) (if 0 {0} {- 5}))
+(print (if {1} {2} {3}))
+(print (choose 1 5 {0}))
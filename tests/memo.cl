@@ -0,0 +1,11 @@
+; `memo` returns a lambda whose calls are memoized, e.g. so that Fibonacci numbers take
+; linear time rather than exponential (as with the prelude's `fib`).
+(def {fast-fib} (memo (\ {n} {
+    select
+        {(== n 0) 0}
+        {(== n 1) 1}
+        {otherwise (+ (fast-fib (- n 1)) (fast-fib (- n 2)))}})))
+(print (fib 20) (fast-fib 20) (fast-fib 80))
+(print (memo-stats true))
+(print (fast-fib 80))
+(print (memo-stats false))
@@ -0,0 +1,26 @@
+; Functions on numbers, which are translated to native ones by `--emit-c` (see emit.h),
+; must behave the same whether they're called natively or evaluated.
+(fun {nfib n} {if (< n 2) {n} {+ (nfib (- n 1)) (nfib (- n 2))}})
+(fun {count-to n acc} {if (== n 0) {acc} {count-to (- n 1) (+ acc n)}})
+(fun {square x} {* x x})
+(fun {sum-squares n} {if (<= n 0) {0} {+ (square n) (sum-squares (- n 1))}})
+(print (nfib 20) (count-to 1000000 0) (sum-squares 100) (- 5) (- -5 (- -5)))
+
+; Errors (and calls too deep to be made natively) are evaluated as usual.
+(fun {ratio a b} {/ a b})
+(print (ratio 7 2))
+(print (ratio 7 0))
+(print (sum-squares 3000))
+(print (nfib {1}))
+
+; So are calls once a name they use refers to something else.
+(fun {with-plus + n} {nfib n})
+(print (with-plus - 10) (nfib 10))
+(fun {twice n} {step (step n)})
+(fun {step n} {+ n 1})
+(fun {add-two n} {step (step n)})
+(print (add-two 1) (twice 1))
+(fun {step n} {* n 10})
+(print (add-two 1) (twice 1))
+(def {*} +)
+(print (square 5) (add-two 1))
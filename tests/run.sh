@@ -0,0 +1,62 @@
+#!/bin/sh
+# Runs the scripts of tests/ (all of them, or those named) with the given clisp binary
+# (./clisp by default), from the root of the repository so that it loads its prelude, and
+# compares what each of them prints with tests/NAME.out. Each script is run with the
+# default options, then with each of those that select another implementation, which
+# must print the same. So must it with the collector collecting whenever it can (see
+# tests/data/gc-on.cl), and the program it's translated to by `--emit-c`.
+#
+#   $ tests/run.sh ./clisp closures
+#
+# Set CC, CFLAGS and LDLIBS to build those with other than `cc -O2` and editline.
+
+repo=$(cd "$(dirname "$0")/.." && pwd)
+clisp=$(cd "$(dirname "${1:-./clisp}")" && pwd)/$(basename "${1:-./clisp}")
+[ $# -gt 0 ] && shift
+
+names="$*"
+if [ -z "$names" ]; then
+    names=$(cd "$repo/tests" && ls *.cl | sed 's/\.cl$//')
+fi
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-}
+LDLIBS=${LDLIBS--ledit}
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+# The runtime that programs translated by `--emit-c` link against (every source but main.c).
+(cd "$repo" && for src in $(ls *.c | grep -v '^main\.c$') ext/mpc.c; do
+    $CC -std=c99 -O2 $CFLAGS -c "$src" -o "$tmp/$(basename "$src" .c).o" || exit 1
+done) || exit 1
+
+failed=0
+for name in $names; do
+    for options in "" --no-vm --no-fold --no-native-lists; do
+        if (cd "$repo" && "$clisp" $options "tests/$name.cl" 2>&1 | cmp -s - "tests/$name.out"); then
+            echo "ok      $name $options"
+        else
+            echo "FAILED  $name $options"
+            failed=1
+        fi
+    done
+
+    if (cd "$repo" && "$clisp" tests/data/gc-on.cl "tests/$name.cl" 2>&1 | cmp -s - "tests/$name.out"); then
+        echo "ok      $name (gc)"
+    else
+        echo "FAILED  $name (gc)"
+        failed=1
+    fi
+
+    if (cd "$repo" && "$clisp" --emit-c "tests/$name.cl" > "$tmp/$name.c" \
+        && $CC -std=c99 -O2 $CFLAGS -I. "$tmp/$name.c" "$tmp/"*.o -o "$tmp/$name" $LDLIBS \
+        && "$tmp/$name" 2>&1 | cmp -s - "tests/$name.out"); then
+        echo "ok      $name --emit-c"
+    else
+        echo "FAILED  $name --emit-c"
+        failed=1
+    fi
+done
+
+exit $failed
@@ -0,0 +1,19 @@
+; Calls in tail position don't nest, with or without the virtual machine.
+(fun {tc n} {if (== n 0) {"done"} {tc (- n 1)}})
+(print (tc 5000) (tc 100000))
+
+; Including through `do`, `and`, `or` and `eval`.
+(fun {td n} {do (+ 1 1) (if (> n 0) {td (- n 1)} {"do"})})
+(fun {ta n} {and 1 (or 0 (if (> n 0) {ta (- n 1)} {"and/or"}))})
+(fun {te n} {if (== n 0) {"eval"} {eval {te (- n 1)}}})
+(print (td 100000) (ta 100000) (te 100000))
+
+; Mutual recursion keeps the frames (which may still be looked up), but not the stack.
+(fun {is-even n} {if (== n 0) {1} {is-odd (- n 1)}})
+(fun {is-odd n} {if (== n 0) {0} {is-even (- n 1)}})
+(print (is-even 100000))
+
+; A fold over 10M items (10 doubled 20 times, whose sum is 55 * 2^20).
+(fun {double l n} {if (== n 0) {l} {double (join l l) (- n 1)}})
+(def {items} (double {1 2 3 4 5 6 7 8 9 10} 20))
+(print (foldl + 0 items))
@@ -0,0 +1,607 @@
+#include "vm.h"
+#include "fold.h"
+#include "sym.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool lvm_enabled = true;
+
+//
+// Compiler.
+//
+
+typedef struct lvm_compiler {
+    lenv    *global;
+    int     count;
+    int     capacity;
+    linstr  *instrs;
+} lvm_compiler;
+
+// Appends an instruction, and returns its index.
+static int lvm_emit(lvm_compiler *c, const LVM_OP code, const int arg, lval *val) {
+    if (c->count == c->capacity) {
+        c->capacity = c->capacity ? 2 * c->capacity : 16;
+        c->instrs = realloc(c->instrs, c->capacity * sizeof(linstr));
+    }
+
+    c->instrs[c->count] = (linstr){ .code = code, .arg = arg, .val = val };
+    return c->count++;
+}
+
+// Returns whether `k` names a built-in function (for now), and its opcode.
+// Since it may be rebound (or shadowed) by the time the call is run, that's checked again
+// then, either by the call itself or by a guard before its compiled form.
+static bool lvm_builtin_of(lval *k, LOP *op) {
+    if (lval_type_of(k) != LVAL_SYM) return false;
+
+    const int builtin = lsym_builtin(k->sym);
+    if (builtin >= 0) *op = builtin;
+    return builtin >= 0;
+}
+
+// Emits a guard before the compiled form of the call `v` to a built-in, which evaluates
+// it as any other call instead if its name no longer refers to that built-in. Returns its
+// index, whose target (the end of the form) is set by `lvm_end_guard`.
+static int lvm_emit_guard(lvm_compiler *c, lval *v) {
+    return lvm_emit(c, LVM_GUARD, 0, v);
+}
+
+static void lvm_end_guard(lvm_compiler *c, const int guard) {
+    c->instrs[guard].arg = c->count;
+}
+
+static void lvm_compile_sexpr(lvm_compiler *c, lval *v, const bool tail);
+
+// Compiles `v`, which is in tail position if its value is returned by the body.
+static void lvm_compile_expr(lvm_compiler *c, lval *v, const bool tail) {
+    switch (lval_type_of(v)) {
+        case LVAL_SYM:   lvm_emit(c, LVM_LOAD, 0, v);   break;
+        case LVAL_SEXPR: lvm_compile_sexpr(c, v, tail); break;
+        default:         lvm_emit(c, LVM_CONST, 0, v);  break; // evaluates to itself
+    }
+}
+
+// `(if cond {then} {else})`, where the branches are compiled inline:
+//
+//         <cond>
+//         IF    else
+//         <then>
+//         JUMP  end
+//   else: <else>
+//   end:
+static void lvm_compile_if(lvm_compiler *c, lval *v, const bool tail) {
+    lvm_compile_expr(c, v->cell[1], false);
+    const int branch = lvm_emit(c, LVM_IF, 0, v);
+
+    lvm_compile_sexpr(c, v->cell[2], tail);
+    const int jump = lvm_emit(c, LVM_JUMP, 0, NULL);
+
+    c->instrs[branch].arg = c->count;
+    lvm_compile_sexpr(c, v->cell[3], tail);
+    c->instrs[jump].arg = c->count;
+}
+
+// `(and a b ... z)`, `(or a b ... z)` and `(do a b ... z)`, where each argument but the
+// last is followed by `code`, which may jump to the end (keeping its value as the result):
+//
+//         <a>
+//         AND   end
+//         <b>
+//         AND   end
+//         ...
+//         <z>
+//   end:
+static void lvm_compile_sequence(lvm_compiler *c, lval *v, const LVM_OP code, const bool tail) {
+    // The jumps are chained through their targets until the end is known.
+    int chain = -1;
+    for (int i = 1; i < v->cell_count - 1; ++i) {
+        lvm_compile_expr(c, v->cell[i], false);
+        chain = lvm_emit(c, code, chain, v);
+    }
+    lvm_compile_expr(c, v->cell[v->cell_count - 1], tail);
+
+    while (chain >= 0) {
+        const int next = c->instrs[chain].arg;
+        c->instrs[chain].arg = c->count;
+        chain = next;
+    }
+}
+
+// Compiles the cells of `v` as an S-Expression (even if it's a Q-Expression).
+static void lvm_compile_sexpr(lvm_compiler *c, lval *v, const bool tail) {
+    // Empty expression.
+    if (v->cell_count == 0) {
+        lvm_emit(c, LVM_EMPTY, 0, NULL);
+        return;
+    }
+
+    // Single expression.
+    if (v->cell_count == 1) {
+        lvm_compile_expr(c, v->cell[0], tail);
+        return;
+    }
+
+    LOP op;
+    if (lvm_builtin_of(v->cell[0], &op)) {
+        // Calls to pure built-ins on literals are folded (into immediate numbers only).
+        lval *x = lfold_call(c->global, op, v);
+        if (x) {
+            const int guard = lvm_emit_guard(c, v);
+            lvm_emit(c, LVM_CONST, 0, x);
+            lvm_end_guard(c, guard);
+            return;
+        }
+
+        int guard = -1;
+        switch (op) {
+            case LOP_IF:
+                // (Unless its branches are literal, they're evaluated like any arguments,
+                // then `if` evaluates the one it chooses.)
+                if (v->cell_count != 4 || lval_type_of(v->cell[2]) != LVAL_QEXPR
+                    || lval_type_of(v->cell[3]) != LVAL_QEXPR) break;
+                guard = lvm_emit_guard(c, v);
+                if (lfold_enabled && lval_type_of(v->cell[1]) == LVAL_NUM) {
+                    // The condition is known, so only the chosen branch is compiled.
+                    lvm_compile_sexpr(c, v->cell[lval_num_of(v->cell[1]) ? 2 : 3], tail);
+                    lfold.folded++;
+                } else {
+                    lvm_compile_if(c, v, tail);
+                }
+                break;
+
+            case LOP_AND:
+                guard = lvm_emit_guard(c, v);
+                lvm_compile_sequence(c, v, LVM_AND, tail);
+                break;
+
+            case LOP_OR:
+                guard = lvm_emit_guard(c, v);
+                lvm_compile_sequence(c, v, LVM_OR, tail);
+                break;
+
+            case LOP_DO:
+                guard = lvm_emit_guard(c, v);
+                lvm_compile_sequence(c, v, LVM_POP, tail);
+                break;
+
+            case LOP_LET:
+                if (v->cell_count != 2 || lval_type_of(v->cell[1]) != LVAL_QEXPR) break;
+                guard = lvm_emit_guard(c, v);
+                lvm_emit(c, LVM_LET, 0, v->cell[1]);
+                break;
+
+            default:
+                break;
+        }
+        if (guard >= 0) {
+            lvm_end_guard(c, guard);
+            return;
+        }
+
+        for (int i = 1; i < v->cell_count; ++i) lvm_compile_expr(c, v->cell[i], false);
+        const bool eval = op == LOP_EVAL && tail && v->cell_count == 2;
+        lvm_emit(c, eval ? LVM_TAILEVAL : LVM_BUILTIN, v->cell_count - 1, v->cell[0]);
+        return;
+    }
+
+    for (int i = 0; i < v->cell_count; ++i) lvm_compile_expr(c, v->cell[i], false);
+    lvm_emit(c, tail ? LVM_TAILCALL : LVM_CALL, v->cell_count - 1, NULL);
+}
+
+lcode *lvm_compile(lenv *e, lval *body) {
+    lvm_compiler c = { .global = e->global_ref ? e->global_ref : e };
+
+    lvm_compile_sexpr(&c, body, true);
+    lvm_emit(&c, LVM_RETURN, 0, NULL);
+
+    lcode *code = malloc(sizeof(lcode) + c.count * sizeof(linstr));
+    code->count = c.count;
+    code->native = NULL;
+    memcpy(code->instrs, c.instrs, c.count * sizeof(linstr));
+
+    free(c.instrs);
+    return code;
+}
+
+//
+// Virtual machine.
+//
+
+// Operand stack, shared by every (nested) run of the virtual machine.
+static lval **lvm_stack = NULL;
+static int lvm_stack_size = 0;
+static int lvm_sp = 0;
+
+static inline void lvm_push(lval *v) {
+    if (lvm_sp == lvm_stack_size) {
+        lvm_stack_size = lvm_stack_size ? 2 * lvm_stack_size : 256;
+        lvm_stack = realloc(lvm_stack, lvm_stack_size * sizeof(lval *));
+    }
+    lvm_stack[lvm_sp++] = v;
+}
+
+// Pops the top `count` values into a new S-Expression (in the order they were pushed).
+static lval *lvm_pop_sexpr(const int count) {
+    lvm_sp -= count;
+
+    lval *v = lval_reserve(lval_sexpr(), count);
+    for (int i = 0; i < count; ++i) v->cell[i] = lvm_stack[lvm_sp + i];
+    v->cell_count = count;
+    v->store->count += count;
+    return v;
+}
+
+// Calls built-in `op` on the top `argc` values of the stack.
+static lval *lvm_call_builtin(lenv *e, const LOP op, const int argc) {
+    lval **args = lvm_stack + lvm_sp - argc;
+
+    // Arithmetic on (two) immediate numbers, which doesn't need an argument list.
+    if (argc == 2 && lval_is_imm(args[0]) && lval_is_imm(args[1])) {
+        const long x = lval_num_of(args[0]);
+        const long y = lval_num_of(args[1]);
+
+        lval *result = NULL;
+        switch (op) {
+            case LOP_ADD: result = lval_num(x + y);  break;
+            case LOP_SUB: result = lval_num(x - y);  break;
+            case LOP_MUL: result = lval_num(x * y);  break;
+            case LOP_DIV: if (y) result = lval_num(x / y); break; // (reported below)
+            case LOP_LT:  result = lval_num(x < y);  break;
+            case LOP_GT:  result = lval_num(x > y);  break;
+            case LOP_LE:  result = lval_num(x <= y); break;
+            case LOP_GE:  result = lval_num(x >= y); break;
+            case LOP_EQ:  result = lval_num(x == y); break;
+            case LOP_NE:  result = lval_num(x != y); break;
+            default: break;
+        }
+
+        if (result) {
+            lvm_sp -= 2;
+            return result;
+        }
+    }
+
+    // Otherwise, call it like `lval_apply` would, without the function itself.
+    lval *a = lvm_pop_sexpr(argc);
+    for (int i = 0; i < a->cell_count; ++i)
+        if (lval_type_of(a->cell[i]) == LVAL_ERR) return lval_take(a, i);
+
+    return lop_funs[op](e, a);
+}
+
+// Returns the index of the argument of `and` or `or` whose value is checked by `ip`, i.e.
+// the number of instructions that check the previous ones.
+static int lvm_logic_index(const linstr *instrs, const linstr *ip) {
+    int index = 0;
+    for (const linstr *i = instrs; i < ip; ++i)
+        if (i->code == ip->code && i->val == ip->val) index++;
+    return index;
+}
+
+// Binds the top `argc` values of the stack to the formals of the lambda below them, in a
+// new frame called from `e`, as `lval_call` would after building a list of them (but only
+// if they're enough to call it, none of them is an error, and its calls aren't memoized).
+// Then pops them all (but not the lambda), and returns the frame. Otherwise, returns NULL.
+static lenv *lvm_bind(lenv *e, const int argc) {
+    lval **v = lvm_stack + lvm_sp - argc - 1;
+    lval *f = v[0];
+
+    if (lval_type_of(f) != LVAL_FUN || f->builtin || f->body->memo) return NULL;
+    for (int i = 1; i <= argc; ++i)
+        if (lval_type_of(v[i]) == LVAL_ERR) return NULL;
+
+    // Formals bound to single arguments, i.e. those before '&' (if any).
+    const lval *formals = f->formals;
+    int fixed = 0;
+    while (fixed < formals->cell_count && !lval_is_rest(formals->cell[fixed])) fixed++;
+
+    const bool rest = fixed < formals->cell_count;
+    if (rest ? formals->cell_count - fixed != 2 || argc < fixed : argc != fixed) return NULL;
+
+    lenv *frame = lenv_push_frame(f->env);
+    for (int i = 0; i < fixed; ++i) {
+        lenv_put(frame, formals->cell[i], v[i + 1]);
+        lval_free(v[i + 1]);
+    }
+
+    if (rest) {
+        lval *list = argc > fixed ? lvm_pop_sexpr(argc - fixed) : lval_sexpr();
+        list->type = LVAL_QEXPR;
+        lenv_put(frame, formals->cell[fixed + 1], list);
+        lval_free(list);
+    }
+    lvm_sp -= fixed;
+
+    frame->caller_ref = e;
+    frame->global_ref = e->global_ref ? e->global_ref : e;
+    return frame;
+}
+
+// Calls the lambda below the top `argc` values of the stack natively, if it has a native
+// implementation which can (see `lnative`). Then replaces them all by its result, and
+// returns true. Otherwise, returns false.
+static inline bool lvm_call_native(const int argc) {
+    lval **v = lvm_stack + lvm_sp - argc - 1;
+    if (lval_type_of(v[0]) != LVAL_FUN || v[0]->builtin) return false;
+
+    const lnative native = lcode_native(v[0]->body);
+    lval *x = native ? native(v + 1, argc) : NULL;
+    if (!x) return false;
+
+    for (int i = 0; i <= argc; ++i) lval_free(v[i]);
+    lvm_sp -= argc + 1;
+    lvm_push(x);
+    return true;
+}
+
+//
+// Suspended calls.
+//
+
+// The state of a run of a lambda, while it calls another one.
+typedef struct lvm_frame {
+    const linstr    *instrs;
+    const linstr    *ip;     // (the call)
+    lenv            *env;
+    lval            *fun;    // (see `lvm_run`)
+} lvm_frame;
+
+static lvm_frame *lvm_frames = NULL;
+static int lvm_frames_size = 0;
+int lvm_frame_count = 0;
+
+static inline void lvm_suspend(const lvm_frame frame) {
+    if (lvm_frame_count == lvm_frames_size) {
+        lvm_frames_size = lvm_frames_size ? 2 * lvm_frames_size : 64;
+        lvm_frames = realloc(lvm_frames, lvm_frames_size * sizeof(lvm_frame));
+    }
+    lvm_frames[lvm_frame_count++] = frame;
+}
+
+// Compiles the body of a lambda if it's not yet, and threads its code with `labels`.
+static inline const linstr *lvm_instrs_of(lenv *e, lval *body, const void *const *labels) {
+    if (!body->code || !body->code->count) {
+        // (Keeping its native implementation, if it has one.)
+        lcode *code = lvm_compile(e, body);
+        if (body->code) {
+            code->native = body->code->native;
+            free(body->code);
+        }
+        body->code = code;
+#if LVM_THREADED
+        for (int i = 0; i < body->code->count; ++i) {
+            body->code->instrs[i].label = labels[body->code->instrs[i].code];
+        }
+#else
+        (void)labels;
+#endif
+    }
+    return body->code->instrs;
+}
+
+// Each handler either moves on to the next instruction, or dispatches the one `ip` was set to.
+// The switch is only entered once when threading, and on every instruction otherwise.
+#if LVM_THREADED
+#define LVM_CASE(op)    case LVM_##op: lvm_##op
+#define LVM_DISPATCH()  goto *ip->label
+#else
+#define LVM_CASE(op)    case LVM_##op
+#define LVM_DISPATCH()  continue
+#endif
+#define LVM_NEXT()      { ip++; LVM_DISPATCH(); }
+
+lval *lvm_run(lenv *e, lval *body) {
+    lval *err = lval_check_depth();
+    if (err) return err;
+
+#if LVM_THREADED
+    static const void *const labels[] = {
+        [LVM_CONST]    = &&lvm_CONST,
+        [LVM_LOAD]     = &&lvm_LOAD,
+        [LVM_EMPTY]    = &&lvm_EMPTY,
+        [LVM_CALL]     = &&lvm_CALL,
+        [LVM_TAILCALL] = &&lvm_TAILCALL,
+        [LVM_BUILTIN]  = &&lvm_BUILTIN,
+        [LVM_TAILEVAL] = &&lvm_TAILEVAL,
+        [LVM_GUARD]    = &&lvm_GUARD,
+        [LVM_IF]       = &&lvm_IF,
+        [LVM_AND]      = &&lvm_AND,
+        [LVM_OR]       = &&lvm_OR,
+        [LVM_POP]      = &&lvm_POP,
+        [LVM_LET]      = &&lvm_LET,
+        [LVM_JUMP]     = &&lvm_JUMP,
+        [LVM_RETURN]   = &&lvm_RETURN
+    };
+#else
+    static const void *const *const labels = NULL;
+#endif
+
+    // As far as the collector is concerned, this is an evaluation (of the whole body).
+    lval_eval_depth++;
+
+    // Calls suspended by this run are above `entry`.
+    const int entry = lvm_frame_count;
+
+    // The function whose body is being run, unless it's `body` (which our caller owns).
+    lval *fun = NULL;
+
+    const linstr *instrs = lvm_instrs_of(e, body, labels);
+    const linstr *ip = instrs;
+
+    // The call being made (see `lvm_call`).
+    int argc;
+    bool tail;
+
+    while (true) {
+        switch (ip->code) {
+            LVM_CASE(CONST):
+                lvm_push(lval_is_imm(ip->val) ? ip->val : lval_copy(ip->val));
+                LVM_NEXT();
+
+            LVM_CASE(LOAD):
+                lvm_push(lenv_get(e, ip->val));
+                LVM_NEXT();
+
+            LVM_CASE(EMPTY):
+                lvm_push(lval_sexpr());
+                LVM_NEXT();
+
+            LVM_CASE(CALL):
+            LVM_CASE(TAILCALL):
+                argc = ip->arg;
+                tail = ip->code == LVM_TAILCALL;
+            lvm_call: {
+                if (lvm_call_native(argc)) LVM_NEXT();
+
+                lenv *frame = lvm_bind(e, argc);
+                if (!frame) {
+                    lvm_push(lval_apply(e, lvm_pop_sexpr(argc + 1)));
+                    LVM_NEXT();
+                }
+
+                if (tail && lenv_shadows(frame, e)) {
+                    // Nothing can be looked up in this frame anymore, so replace it by the new
+                    // one (which is then returned from as if it had been called by our caller).
+                    frame->caller_ref = e->caller_ref;
+                    lenv_drop_frame();
+                    if (fun) lval_free(fun);
+                } else if ((err = lval_check_depth())) {
+                    lenv_pop_frame();
+                    lval_free(lvm_stack[--lvm_sp]);
+                    lvm_push(err);
+                    LVM_NEXT();
+                } else {
+                    lvm_suspend((lvm_frame){ .instrs = instrs, .ip = ip, .env = e, .fun = fun });
+                }
+
+                // Run the body of the function in place (rather than recursively).
+                e = frame;
+                fun = lvm_stack[--lvm_sp];
+                instrs = lvm_instrs_of(e, fun->body, labels);
+                ip = instrs;
+                LVM_DISPATCH();
+            }
+
+            LVM_CASE(BUILTIN):
+            lvm_builtin: {
+                const int op = lsym_builtin(ip->val->sym);
+                if (op >= 0) {
+                    lvm_push(lvm_call_builtin(e, op, ip->arg));
+                    LVM_NEXT();
+                }
+
+                // Its name was rebound (or is shadowed), so call whatever it refers to now,
+                // slipping it under the arguments.
+                lvm_push(lenv_get(e, ip->val));
+                lval **args = lvm_stack + lvm_sp - 1 - ip->arg;
+                lval *f = args[ip->arg];
+                memmove(args + 1, args, ip->arg * sizeof(lval *));
+                args[0] = f;
+                lvm_push(lval_apply(e, lvm_pop_sexpr(ip->arg + 1)));
+                LVM_NEXT();
+            }
+
+            LVM_CASE(TAILEVAL): {
+                lval *code = lvm_stack[lvm_sp - 1];
+                if (lsym_builtin(ip->val->sym) != LOP_EVAL || lval_type_of(code) != LVAL_QEXPR)
+                    goto lvm_builtin;
+
+                lvm_sp--;
+                lval *call = NULL;
+                lval *x = lval_eval_tail(e, code, &call);
+                lval_free(code);
+                if (x) {
+                    lvm_push(x);
+                    LVM_NEXT();
+                }
+
+                // Its value is that of a call to a lambda, which is then made from here.
+                for (int i = 0; i < call->cell_count; ++i) lvm_push(lval_copy(call->cell[i]));
+                argc = call->cell_count - 1;
+                tail = true;
+                lval_free(call);
+                goto lvm_call;
+            }
+
+            LVM_CASE(GUARD):
+                if (lsym_builtin(ip->val->cell[0]->sym) >= 0) LVM_NEXT();
+
+                lvm_push(lval_eval_list(e, ip->val));
+                ip = instrs + ip->arg - 1;
+                LVM_NEXT();
+
+            LVM_CASE(IF): {
+                lval *cond = lvm_stack[lvm_sp - 1];
+                if (lval_type_of(cond) == LVAL_NUM) {
+                    lvm_sp--;
+                    if (!lval_num_of(cond)) ip = instrs + ip->arg - 1;
+                    lval_free(cond);
+                    LVM_NEXT();
+                }
+
+                // The condition is either an error (which is the result), or of the wrong
+                // type (so let `if` report it). Either way, skip both branches, knowing that
+                // the instruction before the `else` branch jumps past it.
+                if (lval_type_of(cond) != LVAL_ERR) {
+                    lval *a = lval_add(lvm_pop_sexpr(1), lval_copy(ip->val->cell[2]));
+                    lvm_push(lval_builtin_if(e, lval_add(a, lval_copy(ip->val->cell[3]))));
+                }
+                ip = instrs + instrs[ip->arg - 1].arg - 1;
+                LVM_NEXT();
+            }
+
+            LVM_CASE(AND):
+            LVM_CASE(OR): {
+                lval *cond = lvm_stack[lvm_sp - 1];
+                if (lval_type_of(cond) == LVAL_NUM && (lval_num_of(cond) != 0) != (ip->code == LVM_OR)) {
+                    lvm_sp--;
+                    lval_free(cond);
+                    LVM_NEXT();
+                }
+
+                // The condition decides the result, or is an error, or isn't a number (which
+                // is reported instead).
+                if (lval_type_of(cond) != LVAL_NUM && lval_type_of(cond) != LVAL_ERR) {
+                    const LOP op = ip->code == LVM_AND ? LOP_AND : LOP_OR;
+                    lvm_stack[lvm_sp - 1] = lval_logic_type_err(op, lvm_logic_index(instrs, ip), cond);
+                    lval_free(cond);
+                }
+                ip = instrs + ip->arg - 1;
+                LVM_NEXT();
+            }
+
+            LVM_CASE(POP):
+                if (lval_type_of(lvm_stack[lvm_sp - 1]) == LVAL_ERR) ip = instrs + ip->arg - 1;
+                else lval_free(lvm_stack[--lvm_sp]);
+                LVM_NEXT();
+
+            LVM_CASE(LET):
+                lvm_push(lval_eval_scoped(e, ip->val));
+                LVM_NEXT();
+
+            LVM_CASE(JUMP):
+                ip = instrs + ip->arg - 1;
+                LVM_NEXT();
+
+            LVM_CASE(RETURN): {
+                if (lvm_frame_count == entry) {
+                    if (fun) lval_free(fun);
+                    lval_eval_depth--;
+                    return lvm_stack[--lvm_sp];
+                }
+
+                // Resume the caller, leaving the result on the stack as the value of its call.
+                lenv_pop_frame();
+                lval_free(fun);
+
+                const lvm_frame *caller = &lvm_frames[--lvm_frame_count];
+                instrs = caller->instrs;
+                ip = caller->ip;
+                e = caller->env;
+                fun = caller->fun;
+                LVM_NEXT();
+            }
+        }
+    }
+}
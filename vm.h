@@ -0,0 +1,99 @@
+#ifndef __CLISP_VM_H__
+#define __CLISP_VM_H__
+
+#include "lval.h"
+
+// A compiler from the bodies of lambdas to bytecode, and a stack-based virtual machine
+// which runs it, so that calling a function no longer copies, walks and rebuilds its body.
+//
+// Bodies are compiled the first time their function is called. Each (nested) expression
+// pushes its value on the operand stack, so a call pops its function and arguments from
+// it, whereas special forms become jumps: `if` over branches that are compiled inline
+// (when they're literal), and `and`, `or` and `do` past their remaining arguments. Calls
+// to other built-ins skip looking them up, and arithmetic on immediate numbers skips
+// building their argument list. Since their names can be rebound (or shadowed by formals),
+// each of these checks that its name still refers to the built-in it was compiled for
+// (see `lsym_builtin`), and otherwise is evaluated as any other call. Code that is built
+// at runtime (i.e. passed to `eval`) is still evaluated by `lval_eval`.
+//
+// Calls from one lambda to another don't nest runs of the virtual machine (nor take any
+// native stack): the caller is suspended on a heap-allocated stack, and resumed once the
+// callee returns. Calls in tail position (i.e. whose result is that of the body, including
+// through the branches of an `if` or the last argument of `and`, `or` and `do`) even
+// replace the frame of their caller, as long as nothing could still be looked up in it.
+// Since scope is dynamic, that is when the new frame shadows it, e.g. for self-recursive
+// calls. So does a call which is the value of the code passed to `eval` in tail position
+// (which is evaluated as such, see `lval_eval_tail`).
+
+typedef enum {
+    LVM_CONST,   // pushes (a copy of) `val`
+    LVM_LOAD,    // pushes the value of symbol `val`
+    LVM_EMPTY,   // pushes an empty S-Expression
+    LVM_CALL,    // calls a function on `arg` arguments (all of them popped, then pushed)
+    LVM_TAILCALL, // likewise, then returns (replacing the current frame if possible)
+    LVM_BUILTIN, // calls the built-in named `val` on `arg` arguments (looked up after them)
+    LVM_TAILEVAL, // likewise for `eval` in tail position (making the call its code ends with)
+    LVM_GUARD,   // unless the head of `val` names a built-in, evaluates `val` and jumps to `arg`
+    LVM_IF,      // pops a condition, and jumps to `arg` if it's false
+    LVM_AND,     // jumps to `arg` if the top of the stack is false (or an error), else pops it
+    LVM_OR,      // likewise if it's true
+    LVM_POP,     // jumps to `arg` if the top of the stack is an error, else pops it
+    LVM_LET,     // pushes the value of `val` in a new scope (see `lval_eval_scoped`)
+    LVM_JUMP,    // jumps to `arg`
+    LVM_RETURN   // returns the top of the stack
+} LVM_OP;
+
+// Instructions are dispatched by jumping straight to the address of their handler, which
+// is stored in each of them once their body is compiled ("direct threading"). That relies
+// on computed goto (a GCC extension, which Clang supports too), so other compilers (or
+// building with `-DLVM_NO_THREADING`) fall back to a switch on their code. (Both are
+// compared by `bench/run.sh -D LVM_NO_THREADING dispatch`.)
+#if defined(__GNUC__) && !defined(LVM_NO_THREADING)
+#define LVM_THREADED true
+#else
+#define LVM_THREADED false
+#endif
+
+typedef struct linstr {
+    LVM_OP      code;
+    int         arg;   // number of arguments, or target of a jump
+    lval        *val;  // (borrowed from the body, which outlives its code)
+#if LVM_THREADED
+    const void  *label; // (the handler of `code`, set by `lvm_run`)
+#endif
+} linstr;
+
+// A native implementation of a lambda (see emit.h), which returns the result of calling it
+// on the `count` arguments `args` (without taking ownership of them), or NULL if it can't
+// (e.g. if they aren't numbers), in which case the lambda is called as usual.
+typedef lval *(*lnative)(lval *const *args, const int count);
+
+struct lcode {
+    int         count;  // (0 until the body is actually compiled)
+    lnative     native; // (NULL for most lambdas)
+    linstr      instrs[];
+};
+
+static inline size_t lcode_size(const lcode *c) {
+    return sizeof(lcode) + c->count * sizeof(linstr);
+}
+
+// Returns the native implementation of the lambda whose body is `body`, if it has one.
+static inline lnative lcode_native(const lval *body) {
+    return body->code ? body->code->native : NULL;
+}
+
+// Whether lambdas are run by the virtual machine at all (on by default, see `--no-vm`).
+extern bool lvm_enabled;
+
+// Number of calls currently suspended by the virtual machine.
+extern int lvm_frame_count;
+
+// Compiles the body of a lambda (a Q-Expression, which is evaluated as an S-Expression).
+// The environment `e` is only used to look up constants.
+lcode *lvm_compile(lenv *e, lval *body);
+
+// Evaluates the body of a lambda on the frame `e`, compiling it first if needed.
+lval *lvm_run(lenv *e, lval *body);
+
+#endif // __CLISP_VM_H__